@@ -4,28 +4,38 @@ struct ClusterBounds {
     vec4 maxPoint;
 };
 
+// Range of the cluster's lights in the light index list
 struct ClusterLights {
+    uint offset;
     uint count;
-    uint lightIndices[711];
 };
 
+const uint LIGHT_LIST_COUNT = 0;
+const uint LIGHT_LIST_FILL = 1;
+
 struct PointLight {
     vec3 position;
     uint visibilityMask;
     vec4 color;
+    vec4 size;  // Voxels covered per axis, merged lights are one face wide rectangles
 };
 
+// How much further than a single voxel a merged light's faces reach from its center
+float lightReach(PointLight light) {
+    return 0.5 * length(light.size.xyz - 1.0);
+}
+
 struct EditorData
 {
     // Camera parameters
     uint frustumCulling;
     uint occlusionCulling;
     uint enableCulling;
-    uint padding0;
+    uint greedyMeshing;
     float zNear;
     float zFar;
     float speed;
-    float padding1;
+    uint chunkLod;
     vec3 position;
     float padding2;
 
@@ -54,8 +64,83 @@ struct IndirectDrawCommand
 };
 
 struct ObjectData {
+    vec4 aabbMin;   // w component stores the voxel step
+    vec4 aabbMax;   // w component stores the full resolution instanceCount
+    uvec4 mesh;     // Greedy mesh firstIndex, indexCount, vertexOffset
+    uvec4 lodCounts; // 2x and 4x instance counts, stored right after the full resolution instances
+    uvec4 bricks;   // First brick and brick count, none for chunks drawn whole
+};
+
+// Full resolution voxels of a 4^3 brick, see Chunk::Brick
+struct Brick {
+    vec4 aabbMin;
+    vec4 aabbMax;
+    uvec4 instances; // First instance from the chunk's instance offset, count
+};
+
+// Culling node, see GPUCullNode
+struct CullNode {
     vec4 aabbMin;
-    vec4 aabbMax; // w component stores the instanceCount
+    vec4 aabbMax;
+    uvec4 chunks;   // First entry in the node chunk list, chunk count
 };
 
+// On screen size a LOD voxel should stay under
+const float LOD_VOXEL_PIXELS = 2.0;
+
+// Coarsest LOD whose voxels still fit in LOD_VOXEL_PIXELS, measured at the nearest point of the chunk's bounding sphere.
+// P11 and viewportHeight turn a world size at a view distance into pixels
+uint chunkLod(ObjectData object, vec3 cameraPosition, float P11, float viewportHeight) {
+    vec3 center = 0.5 * (object.aabbMin.xyz + object.aabbMax.xyz);
+    float radius = 0.5 * length(object.aabbMax.xyz - object.aabbMin.xyz);
+    float dist = distance(cameraPosition, center) - radius;
+    if (dist <= 0.0) return 0;
+
+    float voxelPixels = object.aabbMin.w * abs(P11) * 0.5 * viewportHeight / dist;
+    return uint(clamp(floor(log2(LOD_VOXEL_PIXELS / voxelPixels)), 0.0, 2.0));
+}
+
+// cube.obj indices are grouped by face in VoxelFace order, see ArxModel::Builder::groupTrianglesByFace
+const uint CUBE_FACE_INDICES = 6;
+
+// VoxelFace bits of the face directions with a voxel face the camera could see the front of. A +x face at plane x
+// is front facing from x' > x, and the +x planes inside a box are no lower than aabbMin.x
+uint facingFaces(vec3 aabbMin, vec3 aabbMax, vec3 cameraPosition) {
+    return (cameraPosition.x < aabbMax.x ? 1u  : 0u) |  // -x
+           (cameraPosition.x > aabbMin.x ? 2u  : 0u) |  // +x
+           (cameraPosition.y > aabbMin.y ? 4u  : 0u) |  // +y
+           (cameraPosition.y < aabbMax.y ? 8u  : 0u) |  // -y
+           (cameraPosition.z > aabbMin.z ? 16u : 0u) |  // +z
+           (cameraPosition.z < aabbMax.z ? 32u : 0u);   // -z
+}
+
+// Instanced cubes from the chunk's instance range at the given LOD, or its greedy mesh with the chunk index as the only instance
+IndirectDrawCommand chunkDrawCommand(uint chunkIndex, ObjectData object, uint firstInstance, bool greedyMeshing, uint lod) {
+    IndirectDrawCommand command;
+    command.drawID = chunkIndex;
+    command._padding[0] = 0;
+    command._padding[1] = 0;
+    if (greedyMeshing) {
+        command.indexCount = object.mesh.y;
+        command.instanceCount = 1;
+        command.firstIndex = object.mesh.x;
+        command.vertexOffset = int(object.mesh.z);
+        command.firstInstance = chunkIndex;
+    } else {
+        // Step past finer LODs, stopping early if a coarser one came out empty
+        uint instanceCount = uint(object.aabbMax.w);
+        for (uint i = 0; i < lod && object.lodCounts[i] > 0; ++i) {
+            firstInstance += instanceCount;
+            instanceCount = object.lodCounts[i];
+        }
+        
+        command.indexCount = 36;
+        command.instanceCount = instanceCount;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = firstInstance;
+    }
+    return command;
+}
+
 const float DIFFUSE_MULTIPLIER = 2.5f;
\ No newline at end of file
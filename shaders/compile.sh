@@ -1,6 +1,8 @@
 glslangValidator -V depth_pyramid.comp -o depth_pyramid.spv
 glslangValidator -V occlusion_culling.comp -o occlusion_culling.spv
 glslangValidator -V occlusionEarly_culling.comp -o occlusionEarly_culling.spv
+glslangValidator -V svo_node_culling.comp -o svo_node_culling.spv
+glslangValidator -V brick_culling.comp -o brick_culling.spv
 
 glslangValidator -V fullscreen.vert -o fullscreen.spv
 glslangValidator -V composition.frag -o composition.spv
@@ -11,8 +13,10 @@ glslangValidator -V imgui.frag -o imgui.spv
 
 glslangValidator -V frustum_clusters.comp -o frustum_clusters.spv
 glslangValidator -V cluster_cullLight.comp -o cluster_cullLight.spv
+glslangValidator -V cluster_lightOffsets.comp -o cluster_lightOffsets.spv
 
 glslangValidator -V gbuffer.vert -o gbuffer_vert.spv
+glslangValidator -V gbuffer_mesh.vert -o gbuffer_mesh_vert.spv
 glslangValidator -V gbuffer.frag -o gbuffer_frag.spv
 
 echo "Done."
@@ -18,7 +18,7 @@ layout (binding = 6) readonly buffer PointLightsBuffer {
     PointLight pointLights[];
 };
 
-layout (std430, binding = 7) restrict buffer ClusterLightsBuffer {
+layout (std430, binding = 7) restrict readonly buffer ClusterLightsBuffer {
     ClusterLights clusterLights[];
 };
 
@@ -39,6 +39,10 @@ layout (binding = 10) uniform EditorParams {
     EditorData editorData;
 };
 
+layout (std430, binding = 11) restrict readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
@@ -173,7 +177,7 @@ vec3 LTC_Evaluate(vec3 N, vec3 V, vec3 P, mat3 Minv, vec3 points[4], int faceInd
 
 vec3 calculateAreaLight(PointLight light, vec3 fragPos, vec3 normal, vec3 albedo, int faceIndex) {
     vec3 lightPosViewSpace = (ubo.view * vec4(light.position, 1.0)).xyz;
-    float distanceToLight = length(lightPosViewSpace - fragPos);
+    float distanceToLight = max(length(lightPosViewSpace - fragPos) - lightReach(light), 0.0);
 
     // Early exit for both specular and diffuse if beyond MULTIPLIER * maxDistance
     if (distanceToLight > DIFFUSE_MULTIPLIER * editorData.maxDistance) {
@@ -182,7 +186,7 @@ vec3 calculateAreaLight(PointLight light, vec3 fragPos, vec3 normal, vec3 albedo
 
     vec3 translatedPoints[4];
     for (int j = 0; j < 4; ++j) {
-        translatedPoints[j] = vec3(ubo.view * vec4(light.position + FACE_OFFSET[faceIndex][j], 1.0));
+        translatedPoints[j] = vec3(ubo.view * vec4(light.position + FACE_OFFSET[faceIndex][j] * light.size.xyz, 1.0));
     }
 
     vec3 V = normalize(-fragPos);
@@ -292,7 +296,9 @@ void main() {
     uvec3 tile = uvec3(gl_FragCoord.xy / tileSize, zTile);
     uint tileIndex = tile.x + (tile.y * gridSize.x) + (tile.z * gridSize.x * gridSize.y);
 
-    uint clusterLightCount = clusterLights[tileIndex].count;
+    uint clusterLightOffset = clusterLights[tileIndex].offset;
+    // Lists that ran past the end of the index list are cut short
+    uint clusterLightCount = min(clusterLights[tileIndex].count, uint(lightIndices.length()) - clusterLightOffset);
     
     vec3 finalColor = vec3(0.0);
     
@@ -300,14 +306,14 @@ void main() {
 
     for (uint i = 0; i < clusterLightCount; i++) {
         
-        uint lightIndex = clusterLights[tileIndex].lightIndices[i];
+        uint lightIndex = lightIndices[clusterLightOffset + i];
         PointLight light = pointLights[lightIndex];
         
         if (light.visibilityMask == 0) continue;
 
         vec3 lightPosViewSpace = (ubo.view * vec4(light.position, 1.0)).xyz;
         float distToLight = length(fragPos - lightPosViewSpace);
-        if (distToLight > DIFFUSE_MULTIPLIER * editorData.maxDistance) continue;
+        if (distToLight - lightReach(light) > DIFFUSE_MULTIPLIER * editorData.maxDistance) continue;
         if (distToLight < EPSILON) {
             finalColor = light.color.rgb * light.color.a;
             break;
@@ -316,7 +322,7 @@ void main() {
 //        finalColor += calculatePointLight(light, fragPos, normal, albedo);
 
         for (int faceIndex = 0; faceIndex < 6; ++faceIndex) {
-            vec3 lightFacePos = (ubo.view * vec4(light.position + getOffset(faceIndex), 1.0f)).xyz;
+            vec3 lightFacePos = (ubo.view * vec4(light.position + getOffset(faceIndex) * light.size.xyz, 1.0f)).xyz;
             vec3 lightFaceNormal = normalize((ubo.view * getNormal(faceIndex)).xyz);
             vec3 lightToFrag = normalize(fragPos - lightFacePos);
     
@@ -11,11 +11,11 @@ layout (location = 1) out vec3 outPosView;
 layout (location = 2) out vec3 outNormalView;
 layout (location = 3) out vec2 outUV;
 
-struct InstanceData {
-    vec4 translation;
-    vec4 color;
-    uint visibilityMask;
-    uint _padding[3];
+// data: bits 0-11 position in voxel steps from the chunk origin (4 bits per axis),
+// 12-18 visibilityMask, 19-26 palette index, 27-28 LOD
+struct PackedInstance {
+    uint chunkIndex;
+    uint data;
 };
 
 layout (set = 0, binding = 0) uniform GlobalUbo {
@@ -25,7 +25,16 @@ layout (set = 0, binding = 0) uniform GlobalUbo {
 } ubo;
 
 layout (set = 0, binding = 1) readonly buffer InstanceDataBuffer {
-    InstanceData instances[];
+    PackedInstance instances[];
+};
+
+// xyz origin, w voxel step
+layout (set = 0, binding = 2) readonly buffer ChunkOriginBuffer {
+    vec4 chunkOrigins[];
+};
+
+layout (set = 0, binding = 3) readonly buffer PaletteBuffer {
+    vec4 palette[];
 };
 
 layout (push_constant) uniform Push {
@@ -45,7 +54,8 @@ int getFaceIndex(vec3 normal) {
 void main() {
     // gl_InstanceIndex bounds are [firstInstance, firstInstance + baseInstance]
     // where these are set in the drawCommand
-    InstanceData instance = instances[gl_InstanceIndex];
+    PackedInstance instance = instances[gl_InstanceIndex];
+    uint visibilityMask = (instance.data >> 12) & 0x7Fu;
     
     // Transform the normal to world space
     vec3 worldNormal = normalize(mat3(push.modelMatrix) * inNormal);
@@ -54,20 +64,24 @@ void main() {
     int faceIndex = getFaceIndex(worldNormal);
 
     // Check visibility
-    if ((instance.visibilityMask & (1u << faceIndex)) == 0) {
+    if ((visibilityMask & (1u << faceIndex)) == 0) {
         // Face is occluded or voxel is a light source, move the vertex outside of clip space
         gl_Position = vec4(1, 1, 1, 0);
         return;
     }
     
-    vec4 positionWorld = push.modelMatrix * vec4(inPos, 1.0);
-    positionWorld.xyz += instance.translation.xyz;
+    // LOD voxels span 2^LOD steps and are packed at their lowest child, center them over all of it
+    float lodScale = float(1u << ((instance.data >> 27) & 0x3u));
+    vec4 positionWorld = push.modelMatrix * vec4(inPos * lodScale, 1.0);
+    vec4 origin = chunkOrigins[instance.chunkIndex];
+    uvec3 localPosition = uvec3(instance.data, instance.data >> 4, instance.data >> 8) & 0xFu;
+    positionWorld.xyz += origin.xyz + (vec3(localPosition) + 0.5 * (lodScale - 1.0)) * origin.w;
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
     mat3 normalViewMatrix = mat3(ubo.view * push.modelMatrix);
     
     outNormalView = normalViewMatrix * inNormal;
     outPosView = vec3(ubo.view * positionWorld);
-    outColor = instance.color;
+    outColor = palette[(instance.data >> 19) & 0xFFu];
     outUV = inUV;
 }
@@ -0,0 +1,56 @@
+#version 460
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) out vec3 outPosView;
+layout (location = 2) out vec3 outNormalView;
+layout (location = 3) out vec2 outUV;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+} ubo;
+
+// xyz origin, w voxel step
+layout (set = 0, binding = 2) readonly buffer ChunkOriginBuffer {
+    vec4 chunkOrigins[];
+};
+
+layout (set = 0, binding = 3) readonly buffer PaletteBuffer {
+    vec4 palette[];
+};
+
+// Bits 0-11 corner position in voxel steps from the chunk origin (4 bits per axis),
+// 12-14 face, 15-22 palette index
+layout (set = 0, binding = 4) readonly buffer MeshVertexBuffer {
+    uint meshVertices[];
+};
+
+// Same order as the visibilityMask bits
+const vec3 faceNormals[6] = vec3[](
+    vec3(-1.0,  0.0,  0.0),
+    vec3( 1.0,  0.0,  0.0),
+    vec3( 0.0,  1.0,  0.0),
+    vec3( 0.0, -1.0,  0.0),
+    vec3( 0.0,  0.0,  1.0),
+    vec3( 0.0,  0.0, -1.0)
+);
+
+void main() {
+    // Chunk meshes are drawn as a single instance with firstInstance set to the chunk index
+    // and gl_VertexIndex already includes the chunk's vertexOffset
+    uint vertex = meshVertices[gl_VertexIndex];
+    vec4 origin = chunkOrigins[gl_InstanceIndex];
+
+    uvec3 corner = uvec3(vertex, vertex >> 4, vertex >> 8) & 0xFu;
+    vec3 normal = faceNormals[(vertex >> 12) & 0x7u];
+
+    // Voxels are unit cubes centered on their translation, corners sit half a step below
+    vec4 positionWorld = vec4(origin.xyz + (vec3(corner) - 0.5) * origin.w, 1.0);
+    gl_Position = ubo.projection * ubo.view * positionWorld;
+
+    outNormalView = mat3(ubo.view) * normal;
+    outPosView = vec3(ubo.view * positionWorld);
+    outColor = palette[(vertex >> 15) & 0xFFu];
+    outUV = vec2(0.0);
+}
@@ -3,13 +3,11 @@
 #include "../source/app.h"
 #include "../source/user_input.h"
 #include "../source/arx_buffer.h"
+#include "../source/arx_uploader.h"
 #include "../source/systems/clustered_shading_system.hpp"
 #include "../source/geometry/blockMaterials.hpp"
 #include "../source/editor/profiling/arx_profiler.hpp"
 
-#define OGT_VOX_IMPLEMENTATION
-#include "../libs/ogt_vox.h"
-
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
@@ -26,7 +24,7 @@ namespace arx {
         editor->setRenderPass(arxRenderer->getSwapChain()->getRenderPass());
         editor->init();
 
-        Logger::setEditor(editor);
+        Logger::setSink([editor = editor](const std::string& message) { editor->addLogMessage(message); });
 
         // Hardcode number of timestamps
         Profiler::initializeGPUProfiler(arxDevice, 20);
@@ -39,6 +37,7 @@ namespace arx {
         BufferManager::cleanup();
 
         gameObjects.clear();
+        ArxModel::clearMeshCache();
         chunkManager.reset();
         rpManager.reset();
         textureManager.reset();
@@ -63,9 +62,7 @@ namespace arx {
         // Since voxels share the same vertex and index buffer we can bind those once and do multi draw indirect
         BufferManager::createLargeInstanceBuffer(arxDevice, ArxModel::getTotalInstances());
         uint32_t chunkCount = static_cast<uint32_t>(chunkManager->getChunkAABBs().size());
-        // Initialize the maximum indirect draw size
-        BufferManager::indirectDrawData.resize(chunkCount);
-        ARX_LOG_INFO("Total voxels: {}", ArxModel::getTotalInstances());
+        ARX_LOG_INFO("Total voxel instances, LODs included: {}", ArxModel::getTotalInstances());
         
         auto viewerObject = ArxGameObject::createGameObject();
         viewerObject.transform.scale = glm::vec3(0.1);
@@ -80,26 +77,26 @@ namespace arx {
         camera.setPerspectiveProjection(glm::radians(60.f), aspect, Editor::data.camera.zNear, Editor::data.camera.zFar);
         chunkManager->setCamera(camera);
         
-        std::vector<std::unique_ptr<ArxBuffer>> uboBuffers(ArxSwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < uboBuffers.size(); i++) {
-            uboBuffers[i] = std::make_unique<ArxBuffer>(arxDevice,
-                                                        sizeof(GlobalUbo),
-                                                        1,
-                                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-            uboBuffers[i]->map();
-        }
-
+        // Descriptors of per-frame uniforms point at the ring, it has to exist before they are written
+        BufferManager::createFrameRing(arxDevice);
+        
         ClusteredShading::init(arxDevice, WIDTH, HEIGHT);
         arxRenderer->init_Passes();
 
         // Set data for occlusion culling
         {
             arxRenderer->getSwapChain()->cull->setObjectDataFromAABBs(*chunkManager.get());
+            // Initialize the maximum indirect draw size, instanced cubes take a draw per face direction facing the camera
+            BufferManager::indirectDrawData.resize(arxRenderer->getSwapChain()->cull->maxDrawCommands());
             arxRenderer->getSwapChain()->cull->setViewProj(camera.getProjection(), camera.getView(), camera.getInverseView());
             arxRenderer->getSwapChain()->cull->setGlobalData(camera.getProjection(), arxRenderer->getSwapChain()->height(), arxRenderer->getSwapChain()->height(), chunkCount);
             arxRenderer->getSwapChain()->loadGeometryToDevice();
         }
+        
+        // Scene, pass and culling uploads were only batched so far, land them all in one go before the first frame
+        arxDevice.uploader().commit();
+        BufferManager::releaseInstanceBuffers();
+        arxDevice.allocator().logStats();
 
         auto currentTime = std::chrono::high_resolution_clock::now();
         while (!arxWindow.shouldClose()) {
@@ -129,6 +126,10 @@ namespace arx {
             {
                 arxRenderer->getSwapChain()->cull->miscData.frustumCulling = Editor::data.camera.frustumCulling;
                 arxRenderer->getSwapChain()->cull->miscData.occlusionCulling = Editor::data.camera.occlusionCulling;
+                arxRenderer->getSwapChain()->cull->miscData.chunkLod = Editor::data.camera.chunkLod;
+                // Frozen draw commands keep the layout they were culled with
+                if (!Editor::data.camera.disableCulling)
+                    arxRenderer->getSwapChain()->cull->miscData.greedyMeshing = Editor::data.camera.greedyMeshing;
                 viewerObject.transform.translation = Editor::data.camera.position;
             }
             
@@ -138,6 +139,7 @@ namespace arx {
             // beginFrame() will return nullptr if the swapchain need to be recreated
             if (auto commandBuffer = arxRenderer->beginFrame()) {
                 int frameIndex = arxRenderer->getFrameIndex();
+                BufferManager::updateDrawCommandStats(frameIndex);
                 FrameInfo frameInfo{
                     frameIndex,
                     frameTime,
@@ -151,8 +153,13 @@ namespace arx {
                 if (!Editor::data.camera.disableCulling) {
                     Profiler::startStageTimer("Occlusion Culling #1", Profiler::Type::GPU, commandBuffer);
                     // Early cull: frustum cull and fill objects that *were* visible last frame
-                    BufferManager::resetDrawCommandCountBuffer(frameInfo.commandBuffer);
-                    arxRenderer->getSwapChain()->computeCulling(commandBuffer, chunkCount, true);
+                    BufferManager::resetDrawCommandCountBuffer(arxDevice, frameInfo.commandBuffer, frameIndex);
+                    // Both culling passes read this frame's push. The G-pass below picks its pipeline from this frame's
+                    // greedyMeshing, the draws have to match
+                    arxRenderer->getSwapChain()->cull->setViewProj(camera.getProjection(), camera.getView(), camera.getInverseView());
+                    arxRenderer->getSwapChain()->cull->setGlobalData(camera.getProjection(), arxRenderer->getSwapChain()->height(), arxRenderer->getSwapChain()->height(), chunkCount);
+                    arxRenderer->getSwapChain()->updateDynamicData();
+                    arxRenderer->getSwapChain()->computeCulling(commandBuffer, frameIndex, true);
                     Profiler::stopStageTimer("Occlusion Culling #1", Profiler::Type::GPU, commandBuffer);
                 }
                 
@@ -164,8 +171,6 @@ namespace arx {
                 // Don't update zNear and zFar for the screenspace techniques and especially the frustum cluster
                 ubo.zNear           = 0.1f;
                 ubo.zFar            = 1024.f;
-                uboBuffers[frameIndex]->writeToBuffer(&ubo);
-                uboBuffers[frameIndex]->flush();
 
                 // Update misc for the rest of the render passes
                 CompositionParams compParams{};
@@ -175,6 +180,11 @@ namespace arx {
                 compParams.deferred = Editor::data.lighting.deferred;
                 
                 arxRenderer->updateUniforms(ubo, compParams);
+                // beginFrame waited on this frame's fence, its light buffer is free to write
+                if (Materials::flush(arxDevice, frameIndex)) {
+                    arxRenderer->updateLightBuffer(frameIndex);
+                    ClusteredShading::updateLightBuffer(frameIndex);
+                }
                 ClusteredShading::updateUniforms(ubo, glm::vec2(arxWindow.getExtend().width, arxWindow.getExtend().height), Editor::data.lighting.perLightMaxDistance);
 
                 // Passes
@@ -183,9 +193,6 @@ namespace arx {
                 if (!Editor::data.camera.disableCulling) {
                     // Calculate the depth pyramid
                     Profiler::startStageTimer("Depth Pyramid", Profiler::Type::GPU, commandBuffer);
-                    arxRenderer->getSwapChain()->cull->setViewProj(camera.getProjection(), camera.getView(), camera.getInverseView());
-                    arxRenderer->getSwapChain()->cull->setGlobalData(camera.getProjection(), arxRenderer->getSwapChain()->height(), arxRenderer->getSwapChain()->height(), chunkCount);
-                    arxRenderer->getSwapChain()->updateDynamicData();
                     arxRenderer->getSwapChain()->computeDepthPyramid(commandBuffer);
                     Profiler::stopStageTimer("Depth Pyramid", Profiler::Type::GPU, commandBuffer);
                 }
@@ -193,13 +200,12 @@ namespace arx {
                 if (!Editor::data.camera.disableCulling) {
                     // Late cull: frustum + occlusion cull and fill objects that were *not* visible last frame
                     Profiler::startStageTimer("Occlusion Culling #2", Profiler::Type::GPU, commandBuffer);
-                    arxRenderer->getSwapChain()->computeCulling(commandBuffer, chunkCount);
+                    arxRenderer->getSwapChain()->computeCulling(commandBuffer, frameIndex);
                     Profiler::stopStageTimer("Occlusion Culling #2", Profiler::Type::GPU, commandBuffer);
                 }
 
                 arxRenderer->endFrame();
             }
-            vkDeviceWaitIdle(arxDevice.device());
         }
     }
 }
@@ -0,0 +1,351 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/arx_allocator.h"
+
+namespace arx {
+
+    namespace {
+        VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    ArxAllocator::ArxAllocator(ArxDevice &device) : arxDevice{device} {
+        vkGetPhysicalDeviceMemoryProperties(arxDevice.getPhysicalDevice(), &memoryProperties);
+    }
+
+    ArxAllocator::~ArxAllocator() {
+        const Stats leaked = stats();
+        if (leaked.allocations > 0)
+            ARX_LOG_WARNING("{} GPU allocations still alive at shutdown", leaked.allocations);
+
+        for (ArxAllocation* allocation : dedicated) {
+            vkFreeMemory(arxDevice.device(), allocation->memory, nullptr);
+            delete allocation;
+        }
+        for (auto& [key, pool] : pools) {
+            for (auto& block : pool.blocks) {
+                for (ArxAllocation* allocation : block->allocations)
+                    delete allocation;
+                vkFreeMemory(arxDevice.device(), block->memory, nullptr);
+            }
+        }
+    }
+
+    uint32_t ArxAllocator::orderOf(VkDeviceSize size) {
+        uint32_t order = 0;
+        while ((MIN_NODE_SIZE << order) < size)
+            ++order;
+        return order;
+    }
+
+    ArxAllocation* ArxAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, Strategy strategy) {
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(arxDevice.device(), buffer, &requirements);
+
+        ArxAllocation* allocation = allocate(requirements, properties, false, strategy);
+        if (vkBindBufferMemory(arxDevice.device(), buffer, allocation->memory, allocation->offset) != VK_SUCCESS) {
+            ARX_LOG_ERROR("failed to bind buffer memory!");
+        }
+        return allocation;
+    }
+
+    ArxAllocation* ArxAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags properties) {
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(arxDevice.device(), image, &requirements);
+
+        ArxAllocation* allocation = allocate(requirements, properties, true, Strategy::Buddy);
+        if (vkBindImageMemory(arxDevice.device(), image, allocation->memory, allocation->offset) != VK_SUCCESS) {
+            ARX_LOG_ERROR("failed to bind image memory!");
+        }
+        return allocation;
+    }
+
+    ArxAllocation* ArxAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool image, Strategy strategy) {
+        const uint32_t memoryType = arxDevice.findMemoryType(requirements.memoryTypeBits, properties);
+        const VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+
+        auto [it, inserted] = pools.try_emplace({memoryType, image, strategy});
+        Pool& pool = it->second;
+        if (inserted) {
+            pool.memoryType  = memoryType;
+            pool.strategy    = strategy;
+            pool.hostVisible = typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            // Keeps flush and invalidate ranges of neighbouring allocations apart
+            const bool nonCoherent = pool.hostVisible && !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            pool.atomSize = nonCoherent ? arxDevice.properties.limits.nonCoherentAtomSize : 1;
+        }
+
+        const VkDeviceSize size      = alignUp(requirements.size, pool.atomSize);
+        const VkDeviceSize alignment = std::max(requirements.alignment, pool.atomSize);
+
+        auto allocation = std::make_unique<ArxAllocation>();
+        allocation->size      = requirements.size;
+        allocation->alignment = alignment;
+        allocation->atomSize  = pool.atomSize;
+
+        Placement placement;
+        if (size <= BLOCK_SIZE / 2 && place(pool, size, alignment, nullptr, placement)) {
+            allocation->pool     = &pool;
+            allocation->block    = placement.block;
+            allocation->memory   = placement.block->memory;
+            allocation->offset   = placement.offset;
+            allocation->reserved = placement.reserved;
+            if (placement.block->mapped)
+                allocation->mapped = static_cast<char*>(placement.block->mapped) + placement.offset;
+
+            placement.block->used += allocation->size;
+            placement.block->allocations.insert(allocation.get());
+            return allocation.release();
+        }
+
+        allocation->memory   = allocateMemory(size, memoryType, &allocation->mapped);
+        allocation->reserved = size;
+        dedicated.insert(allocation.get());
+        return allocation.release();
+    }
+
+    bool ArxAllocator::place(Pool& pool, VkDeviceSize size, VkDeviceSize alignment, const Block* exclude, Placement& placement) {
+        auto tryBlock = [&](Block& block) {
+            if (pool.strategy == Strategy::Linear) {
+                const VkDeviceSize offset = alignUp(block.taken, alignment);
+                if (offset + size > BLOCK_SIZE) return false;
+
+                placement = {&block, offset, offset + size - block.taken};
+                block.taken = offset + size;
+                return true;
+            }
+
+            // Nodes sit at multiples of their own size, so a node as large as the alignment is aligned
+            const uint32_t order = orderOf(std::max(size, alignment));
+            uint32_t split = order;
+            while (split <= MAX_ORDER && block.freeNodes[split].empty())
+                ++split;
+            if (split > MAX_ORDER) return false;
+
+            const VkDeviceSize offset = *block.freeNodes[split].begin();
+            block.freeNodes[split].erase(block.freeNodes[split].begin());
+            while (split > order) {
+                --split;
+                block.freeNodes[split].insert(offset + (MIN_NODE_SIZE << split));
+            }
+
+            placement = {&block, offset, MIN_NODE_SIZE << order};
+            block.taken += placement.reserved;
+            return true;
+        };
+
+        for (auto& block : pool.blocks) {
+            if (block.get() != exclude && tryBlock(*block))
+                return true;
+        }
+
+        // Defragmenting only fills the blocks that already exist
+        if (exclude) return false;
+
+        Block* block = createBlock(pool);
+        return block && tryBlock(*block);
+    }
+
+    void ArxAllocator::release(Pool& pool, Block& block, const ArxAllocation& allocation) {
+        block.used -= allocation.size;
+        block.allocations.erase(const_cast<ArxAllocation*>(&allocation));
+
+        if (pool.strategy == Strategy::Linear) {
+            if (block.allocations.empty())
+                block.taken = 0;
+        }
+        else {
+            VkDeviceSize offset = allocation.offset;
+            uint32_t order = orderOf(allocation.reserved);
+            block.taken -= allocation.reserved;
+
+            while (order < MAX_ORDER) {
+                auto buddy = block.freeNodes[order].find(offset ^ (MIN_NODE_SIZE << order));
+                if (buddy == block.freeNodes[order].end()) break;
+
+                offset = std::min(offset, *buddy);
+                block.freeNodes[order].erase(buddy);
+                ++order;
+            }
+            block.freeNodes[order].insert(offset);
+        }
+
+        if (!block.allocations.empty()) return;
+
+        // Keep one empty block around so a pool that drains and refills doesn't hit vkAllocateMemory every time
+        const auto emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                               [](const auto& other) { return other->allocations.empty(); });
+        if (emptyBlocks > 1) {
+            vkFreeMemory(arxDevice.device(), block.memory, nullptr);
+            --deviceAllocations;
+            std::erase_if(pool.blocks, [&](const auto& other) { return other.get() == &block; });
+        }
+    }
+
+    ArxAllocator::Block* ArxAllocator::createBlock(Pool& pool) {
+        auto block = std::make_unique<Block>();
+        block->memory = allocateMemory(BLOCK_SIZE, pool.memoryType, pool.hostVisible ? &block->mapped : nullptr);
+        if (block->memory == VK_NULL_HANDLE) return nullptr;
+
+        if (pool.strategy == Strategy::Buddy)
+            block->freeNodes[MAX_ORDER].insert(0);
+
+        pool.blocks.push_back(std::move(block));
+        return pool.blocks.back().get();
+    }
+
+    VkDeviceMemory ArxAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+        if (deviceAllocations >= arxDevice.properties.limits.maxMemoryAllocationCount) {
+            ARX_LOG_ERROR("Reached maxMemoryAllocationCount of {}", arxDevice.properties.limits.maxMemoryAllocationCount);
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize  = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (vkAllocateMemory(arxDevice.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            ARX_LOG_ERROR("failed to allocate {} bytes of memory type {}!", size, memoryType);
+            return VK_NULL_HANDLE;
+        }
+        ++deviceAllocations;
+
+        // Host visible memory stays mapped for its whole lifetime, allocations in it share the one mapping
+        if (mapped && (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            vkMapMemory(arxDevice.device(), memory, 0, VK_WHOLE_SIZE, 0, mapped);
+
+        return memory;
+    }
+
+    void ArxAllocator::free(ArxAllocation* allocation) {
+        if (!allocation) return;
+
+        if (allocation->pool) {
+            release(*allocation->pool, *allocation->block, *allocation);
+        }
+        else {
+            vkFreeMemory(arxDevice.device(), allocation->memory, nullptr);
+            --deviceAllocations;
+            dedicated.erase(allocation);
+        }
+        delete allocation;
+    }
+
+    VkMappedMemoryRange ArxAllocator::mappedRange(const ArxAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const {
+        // Sizes and offsets were rounded to the atom when placed, so the widened range stays inside the allocation
+        const VkDeviceSize begin = allocation.offset + offset;
+        const VkDeviceSize end   = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+
+        VkMappedMemoryRange range{};
+        range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.memory;
+        range.offset = begin / allocation.atomSize * allocation.atomSize;
+        range.size   = alignUp(end, allocation.atomSize) - range.offset;
+        return range;
+    }
+
+    VkResult ArxAllocator::flush(const ArxAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+        const VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkFlushMappedMemoryRanges(arxDevice.device(), 1, &range);
+    }
+
+    VkResult ArxAllocator::invalidate(const ArxAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) {
+        const VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+        return vkInvalidateMappedMemoryRanges(arxDevice.device(), 1, &range);
+    }
+
+    VkDeviceSize ArxAllocator::defragment(VkDeviceSize maxBytes) {
+        VkDeviceSize moved = 0;
+
+        for (auto& [key, pool] : pools) {
+            if (pool.blocks.size() < 2) continue;
+
+            Block* source = std::min_element(pool.blocks.begin(), pool.blocks.end(),
+                                             [](const auto& a, const auto& b) { return a->used < b->used; })->get();
+
+            // release may drop the block once it runs empty, so work off a copy
+            const std::vector<ArxAllocation*> candidates(source->allocations.begin(), source->allocations.end());
+            for (ArxAllocation* allocation : candidates) {
+                if (!allocation->onMove || moved + allocation->size > maxBytes) continue;
+
+                const VkDeviceSize size = alignUp(allocation->size, allocation->atomSize);
+                Placement placement;
+                if (!place(pool, size, allocation->alignment, source, placement)) continue;
+
+                ArxAllocation target;
+                target.memory = placement.block->memory;
+                target.offset = placement.offset;
+                target.size   = allocation->size;
+                if (placement.block->mapped)
+                    target.mapped = static_cast<char*>(placement.block->mapped) + placement.offset;
+
+                // Hand the placement back when the owner can't move, a linear one was the last bump
+                if (!allocation->onMove(*allocation, target)) {
+                    if (pool.strategy == Strategy::Linear) {
+                        placement.block->taken -= placement.reserved;
+                    }
+                    else {
+                        ArxAllocation rollback;
+                        rollback.offset   = placement.offset;
+                        rollback.reserved = placement.reserved;
+                        placement.block->allocations.insert(&rollback);
+                        release(pool, *placement.block, rollback);
+                    }
+                    continue;
+                }
+
+                const bool last = source->allocations.size() == 1;
+                release(pool, *source, *allocation);
+
+                allocation->block    = placement.block;
+                allocation->memory   = target.memory;
+                allocation->offset   = target.offset;
+                allocation->mapped   = target.mapped;
+                allocation->reserved = placement.reserved;
+                placement.block->used += allocation->size;
+                placement.block->allocations.insert(allocation);
+
+                moved += allocation->size;
+                if (last) break;
+            }
+        }
+
+        return moved;
+    }
+
+    ArxAllocator::Stats ArxAllocator::stats() const {
+        Stats stats;
+        stats.deviceAllocations = deviceAllocations;
+
+        for (const auto& [key, pool] : pools) {
+            for (const auto& block : pool.blocks) {
+                stats.blocks++;
+                stats.allocations += static_cast<uint32_t>(block->allocations.size());
+                stats.capacity    += BLOCK_SIZE;
+                stats.used        += block->used;
+                stats.wasted      += block->taken - block->used;
+            }
+        }
+
+        for (const ArxAllocation* allocation : dedicated) {
+            stats.dedicated++;
+            stats.allocations++;
+            stats.capacity += allocation->reserved;
+            stats.used     += allocation->size;
+            stats.wasted   += allocation->reserved - allocation->size;
+        }
+
+        return stats;
+    }
+
+    void ArxAllocator::logStats() const {
+        const Stats current = stats();
+        constexpr VkDeviceSize MB = 1024 * 1024;
+        ARX_LOG_INFO("GPU memory: {} allocations in {} blocks and {} dedicated, {} of {} vkAllocateMemory calls, {} MB used, {} MB wasted, {} MB reserved",
+                     current.allocations, current.blocks, current.dedicated,
+                     current.deviceAllocations, arxDevice.properties.limits.maxMemoryAllocationCount,
+                     current.used / MB, current.wasted / MB, current.capacity / MB);
+    }
+}
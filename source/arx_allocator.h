@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../source/arx_device.h"
+
+#include <functional>
+
+namespace arx {
+
+    struct ArxAllocation;
+
+    // Sub-allocates resources out of large VkDeviceMemory blocks instead of one vkAllocateMemory each.
+    // Blocks are pooled per memory type and strategy, with buffers and optimal images kept apart so
+    // bufferImageGranularity never matters. Buddy pools hand out power of two nodes that merge back on free,
+    // linear pools bump a pointer that only rewinds once every allocation in the block is gone, which suits
+    // staging and other data that comes and goes together. Requests over half a block get dedicated memory.
+    // Not thread safe
+    class ArxAllocator {
+    public:
+        static constexpr VkDeviceSize BLOCK_SIZE    = 64 * 1024 * 1024;
+        static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+        static constexpr uint32_t     MAX_ORDER     = 18; // MIN_NODE_SIZE << MAX_ORDER == BLOCK_SIZE
+
+        enum class Strategy { Linear, Buddy };
+
+        struct Stats {
+            uint32_t        blocks = 0;
+            uint32_t        dedicated = 0;
+            uint32_t        allocations = 0;
+            uint32_t        deviceAllocations = 0; // Live vkAllocateMemory calls, bounded by maxMemoryAllocationCount
+            VkDeviceSize    capacity = 0;          // Block and dedicated memory
+            VkDeviceSize    used = 0;              // Requested by live allocations
+            VkDeviceSize    wasted = 0;            // Taken from blocks beyond the requests, node rounding, padding and rewound space
+        };
+
+        explicit ArxAllocator(ArxDevice &device);
+        ~ArxAllocator();
+
+        ArxAllocator(const ArxAllocator&) = delete;
+        ArxAllocator& operator=(const ArxAllocator&) = delete;
+
+        // Places and binds the resource, host visible memory comes back mapped
+        ArxAllocation* allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, Strategy strategy = Strategy::Buddy);
+        ArxAllocation* allocateImage(VkImage image, VkMemoryPropertyFlags properties);
+        void free(ArxAllocation* allocation);
+
+        // Ranges are relative to the allocation, VK_WHOLE_SIZE covers all of it. Only needed for non coherent memory
+        VkResult flush(const ArxAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+        VkResult invalidate(const ArxAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+        // Empties the least used block of every pool into the others, moving only allocations with an onMove hook.
+        // The GPU must be done with them, returns the bytes moved
+        VkDeviceSize defragment(VkDeviceSize maxBytes = BLOCK_SIZE);
+
+        Stats stats() const;
+        void logStats() const;
+
+    private:
+        friend struct ArxAllocation;
+
+        struct Block {
+            VkDeviceMemory                          memory = VK_NULL_HANDLE;
+            void*                                   mapped = nullptr;
+            VkDeviceSize                            taken = 0;  // Buddy: nodes handed out, linear: the bump pointer
+            VkDeviceSize                            used = 0;
+            std::unordered_set<ArxAllocation*>      allocations;
+            std::array<std::set<VkDeviceSize>, MAX_ORDER + 1> freeNodes; // Buddy free lists by order
+        };
+
+        struct Pool {
+            uint32_t                                memoryType;
+            Strategy                                strategy;
+            bool                                    hostVisible;
+            VkDeviceSize                            atomSize;   // nonCoherentAtomSize for non coherent types, 1 otherwise
+            std::vector<std::unique_ptr<Block>>     blocks;
+        };
+
+        struct Placement {
+            Block*          block = nullptr;
+            VkDeviceSize    offset = 0;
+            VkDeviceSize    reserved = 0; // Bytes taken from the block
+        };
+
+        ArxAllocation* allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool image, Strategy strategy);
+        bool place(Pool& pool, VkDeviceSize size, VkDeviceSize alignment, const Block* exclude, Placement& placement);
+        void release(Pool& pool, Block& block, const ArxAllocation& allocation);
+        Block* createBlock(Pool& pool);
+        VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+        VkMappedMemoryRange mappedRange(const ArxAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+        static uint32_t orderOf(VkDeviceSize size);
+
+        ArxDevice                                               &arxDevice;
+        VkPhysicalDeviceMemoryProperties                        memoryProperties;
+        std::map<std::tuple<uint32_t, bool, Strategy>, Pool>    pools; // By memory type, whether it holds images and strategy
+        std::unordered_set<ArxAllocation*>                      dedicated;
+        uint32_t                                                deviceAllocations = 0;
+    };
+
+    // Where a resource lives, stays at the same address until freed so owners can hold on to the pointer
+    struct ArxAllocation {
+        VkDeviceMemory  memory = VK_NULL_HANDLE;
+        VkDeviceSize    offset = 0;
+        VkDeviceSize    size = 0;
+        void*           mapped = nullptr; // Start of the allocation, null unless host visible
+
+        // Copies the contents to `to` and rebinds the owning resource there, false keeps it in place. See defragment
+        std::function<bool(const ArxAllocation& from, const ArxAllocation& to)> onMove;
+
+    private:
+        friend class ArxAllocator;
+
+        ArxAllocator::Pool*     pool = nullptr;  // Null when dedicated
+        ArxAllocator::Block*    block = nullptr;
+        VkDeviceSize            alignment = 1;
+        VkDeviceSize            atomSize = 1;
+        VkDeviceSize            reserved = 0;
+    };
+}
@@ -32,7 +32,8 @@ namespace arx {
         uint32_t instanceCount,
         VkBufferUsageFlags usageFlags,
         VkMemoryPropertyFlags memoryPropertyFlags,
-    VkDeviceSize minOffsetAlignment)
+    VkDeviceSize minOffsetAlignment,
+    ArxAllocator::Strategy strategy)
     : arxDevice{device},
       instanceSize{instanceSize},
       instanceCount{instanceCount},
@@ -40,18 +41,31 @@ namespace arx {
       memoryPropertyFlags{memoryPropertyFlags} {
           alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
           bufferSize = alignmentSize * instanceCount;
-          device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+
+          VkBufferCreateInfo bufferInfo{};
+          bufferInfo.sType          = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+          bufferInfo.size           = bufferSize;
+          bufferInfo.usage          = usageFlags;
+          bufferInfo.sharingMode    = VK_SHARING_MODE_EXCLUSIVE;
+
+          if (vkCreateBuffer(device.device(), &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+              ARX_LOG_ERROR("failed to create buffer!");
+          }
+
+          allocation = device.allocator().allocateBuffer(buffer, memoryPropertyFlags, strategy);
     }
 
     ArxBuffer::~ArxBuffer() {
         unmap();
         vkDestroyBuffer(arxDevice.device(), buffer, nullptr);
-        vkFreeMemory(arxDevice.device(), memory, nullptr);
+        arxDevice.allocator().free(allocation);
     }
 
     /**
         * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
         *
+        * @note Host visible blocks stay mapped in the allocator, this only hands out a pointer into them
+        *
         * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
         * buffer range.
         * @param offset (Optional) Byte offset from beginning
@@ -59,20 +73,20 @@ namespace arx {
         * @return VkResult of the buffer mapping call
     */
     VkResult ArxBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(arxDevice.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && allocation && "Called map on buffer before create");
+        if (!allocation->mapped) return VK_ERROR_MEMORY_MAP_FAILED;
+
+        mapped = static_cast<char*>(allocation->mapped) + offset;
+        return VK_SUCCESS;
     }
 
     /**
         * Unmap a mapped memory range
         *
-        * @note Does not return a result as vkUnmapMemory can't fail
+        * @note Does not return a result, the block itself stays mapped
     */
     void ArxBuffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(arxDevice.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     /**
@@ -133,12 +147,7 @@ namespace arx {
         * @return VkResult of the flush call
     */
     VkResult ArxBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(arxDevice.device(), 1, &mappedRange);
+        return arxDevice.allocator().flush(*allocation, size, offset);
     }
 
     /**
@@ -153,12 +162,7 @@ namespace arx {
         * @return VkResult of the invalidate call
     */
     VkResult ArxBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(arxDevice.device(), 1, &mappedRange);
+        return arxDevice.allocator().invalidate(*allocation, size, offset);
     }
 
     /**
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../source/arx_device.h"
+#include "../source/arx_allocator.h"
 
 namespace arx {
 
@@ -12,7 +12,8 @@ class ArxBuffer {
                   uint32_t instanceCount,
                   VkBufferUsageFlags usageFlags,
                   VkMemoryPropertyFlags memoryPropertyFlags,
-                  VkDeviceSize minOffsetAlignment = 1);
+                  VkDeviceSize minOffsetAlignment = 1,
+                  ArxAllocator::Strategy strategy = ArxAllocator::Strategy::Buddy);
         ~ArxBuffer();
         
         ArxBuffer(const ArxBuffer&) = delete;
@@ -40,7 +41,9 @@ class ArxBuffer {
         VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
-        VkDeviceMemory getMemory() const { return memory; }
+        VkDeviceMemory getMemory() const { return allocation->memory; }
+        // Offset of the buffer inside getMemory(), buffers share memory blocks
+        VkDeviceSize getMemoryOffset() const { return allocation->offset; }
         
     private:
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
@@ -48,7 +51,7 @@ class ArxBuffer {
         ArxDevice& arxDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        ArxAllocation* allocation = nullptr;
         
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
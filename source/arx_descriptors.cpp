@@ -179,6 +179,27 @@ namespace arx {
       return *this;
     }
 
+    ArxDescriptorWriter &ArxDescriptorWriter::writeImages(
+        uint32_t binding, VkDescriptorImageInfo *imageInfos, uint32_t count) {
+      assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+      auto &bindingDescription = setLayout.bindings[binding];
+
+      assert(
+          bindingDescription.descriptorCount == count &&
+          "Binding expects as many descriptor infos as its descriptor count");
+
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.descriptorType = bindingDescription.descriptorType;
+      write.dstBinding = binding;
+      write.pImageInfo = imageInfos;
+      write.descriptorCount = count;
+
+      writes.push_back(write);
+      return *this;
+    }
+
     bool ArxDescriptorWriter::build(VkDescriptorSet &set) {
       bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
       if (!success) {
@@ -85,6 +85,7 @@ namespace arx {
 
       ArxDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
       ArxDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+      ArxDescriptorWriter &writeImages(uint32_t binding, VkDescriptorImageInfo *imageInfos, uint32_t count);
 
       bool build(VkDescriptorSet &set);
       void overwrite(VkDescriptorSet &set);
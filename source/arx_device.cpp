@@ -1,6 +1,8 @@
 #include "../source/engine_pch.hpp"
 
 #include "../source/arx_device.h"
+#include "../source/arx_allocator.h"
+#include "../source/arx_uploader.h"
 
 namespace arx {
 
@@ -50,12 +52,16 @@ namespace arx {
             pickPhysicalDevice();
             createLogicalDevice();
             createCommandPool();
+            _allocator = std::make_unique<ArxAllocator>(*this);
+            _uploader = std::make_unique<ArxUploader>(*this);
             numThreads = std::thread::hardware_concurrency();
             assert(numThreads > 0);
             threadPool.setThreadCount(numThreads);
         }
 
         ArxDevice::~ArxDevice() {
+            _uploader.reset();
+            _allocator.reset();
             vkDestroyCommandPool(_device, commandPool, nullptr);
             vkDestroyDevice(_device, nullptr);
 
@@ -138,7 +144,7 @@ namespace arx {
             QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
             std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-            std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+            std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
             float queuePriority = 1.0f;
             for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -161,10 +167,14 @@ namespace arx {
             
             setImagelessFramebufferFeature();
             setBufferDeviceAddressFeature();
+            setTimelineSemaphoreFeature();
+            setDrawIndirectCountFeature();
+            setSamplerFilterMinmaxFeature();
             
             // Need nulldescriptor for scenes that don't have lights
             // Mac doesn't support this feature
             
+            imagelessFramebufferFeatures.pNext = &timelineSemaphoreFeatures;
             bufferDeviceAddressFeatures.pNext = &imagelessFramebufferFeatures;
             deviceFeatures2.pNext = &bufferDeviceAddressFeatures;
 
@@ -175,8 +185,14 @@ namespace arx {
             createInfo.pQueueCreateInfos       = queueCreateInfos.data();
 
             createInfo.pEnabledFeatures        = VK_NULL_HANDLE;
-            createInfo.enabledExtensionCount   = static_cast<uint32_t>(deviceExtensions.size());
-            createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+            std::vector<const char *> enabledExtensions = deviceExtensions;
+            if (drawIndirectCountSupported)
+                enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            if (samplerFilterMinmaxSupported)
+                enabledExtensions.push_back(VK_EXT_SAMPLER_FILTER_MINMAX_EXTENSION_NAME);
+            
+            createInfo.enabledExtensionCount   = static_cast<uint32_t>(enabledExtensions.size());
+            createInfo.ppEnabledExtensionNames = enabledExtensions.data();
             createInfo.pNext                   = &deviceFeatures2;
 
             // might not really be necessary anymore because device specific validation layers
@@ -194,6 +210,11 @@ namespace arx {
 
             vkGetDeviceQueue(_device, indices.graphicsFamily, 0, &_graphicsQueue);
             vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentQueue);
+            vkGetDeviceQueue(_device, indices.transferFamily, 0, &_transferQueue);
+            
+            if (drawIndirectCountSupported)
+                cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR");
+            drawIndirectCountSupported = cmdDrawIndexedIndirectCount != nullptr;
         }
 
         void ArxDevice::createCommandPool() {
@@ -224,8 +245,18 @@ namespace arx {
 
             VkPhysicalDeviceFeatures supportedFeatures;
             vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+            
+            // The uploader hands out timeline values to wait on and has no fence based fallback
+            VkPhysicalDeviceTimelineSemaphoreFeatures supportedTimeline{};
+            supportedTimeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            
+            VkPhysicalDeviceFeatures2 supportedFeatures2{};
+            supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supportedFeatures2.pNext = &supportedTimeline;
+            vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
 
-            return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+            return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy &&
+                   supportedTimeline.timelineSemaphore;
         }
 
         void ArxDevice::setImagelessFramebufferFeature() {
@@ -267,6 +298,43 @@ namespace arx {
                 ARX_LOG_WARNING("BufferDeviceAddress feature is not supported!");
         }
 
+        void ArxDevice::setTimelineSemaphoreFeature() {
+            timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            timelineSemaphoreFeatures.pNext = nullptr;
+
+            VkPhysicalDeviceFeatures2 deviceFeatures2{};
+            deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            deviceFeatures2.pNext = &timelineSemaphoreFeatures;
+
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+
+            // isDeviceSuitable already rejects devices without it, creating the device anyway would fail on the first upload
+            if (timelineSemaphoreFeatures.timelineSemaphore != VK_TRUE) {
+                ARX_LOG_ERROR("failed to set timelineSemaphore!");
+                throw std::runtime_error("timelineSemaphore is required by the uploader");
+            }
+        }
+
+        void ArxDevice::setDrawIndirectCountFeature() {
+            drawIndirectCountSupported = isDeviceExtensionAvailable(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            
+            // The G-pass issues every draw slot and relies on the culling leaving the unused ones empty
+            if (!drawIndirectCountSupported)
+                ARX_LOG_WARNING("{} is not supported, falling back to fixed count indirect draws", VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        void ArxDevice::setSamplerFilterMinmaxFeature() {
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R32_SFLOAT, &formatProperties);
+            
+            samplerFilterMinmaxSupported = isDeviceExtensionAvailable(VK_EXT_SAMPLER_FILTER_MINMAX_EXTENSION_NAME) &&
+                                           (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_MINMAX_BIT);
+            
+            // The depth pyramid lookups fall back to bilinear averages
+            if (!samplerFilterMinmaxSupported)
+                ARX_LOG_WARNING("Min/max sampler reduction is not supported, occlusion culling may cull visible chunks");
+        }
+
         void ArxDevice::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo) {
             createInfo = {};
             createInfo.sType              = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -371,6 +439,20 @@ namespace arx {
             return requiredExtensions.empty();
         }
 
+        bool ArxDevice::isDeviceExtensionAvailable(const char *extensionName) {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+            for (const auto &extension : availableExtensions) {
+                if (strcmp(extension.extensionName, extensionName) == 0)
+                    return true;
+            }
+            return false;
+        }
+
         QueueFamilyIndices ArxDevice::findQueueFamilies(VkPhysicalDevice device) {
             QueueFamilyIndices indices;
 
@@ -380,25 +462,33 @@ namespace arx {
             std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
             vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+            // Every family is visited, a transfer only family tends to come after the graphics one
             int i = 0;
             for (const auto &queueFamily : queueFamilies) {
-                if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                if (!indices.graphicsFamilyHasValue && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                   indices.graphicsFamily = i;
                   indices.graphicsFamilyHasValue = true;
                 }
                 VkBool32 presentSupport = false;
                 vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
-                if (queueFamily.queueCount > 0 && presentSupport) {
+                if (!indices.presentFamilyHasValue && queueFamily.queueCount > 0 && presentSupport) {
                   indices.presentFamily = i;
                   indices.presentFamilyHasValue = true;
                 }
-                if (indices.isComplete()) {
-                  break;
+                // Copy engine families have no graphics or compute, an async compute family will do otherwise
+                if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                  if (!indices.transferFamilyHasValue || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                    indices.transferFamily = i;
+                    indices.transferFamilyHasValue = true;
+                  }
                 }
                 
                 i++;
             }
 
+            if (!indices.transferFamilyHasValue)
+                indices.transferFamily = indices.graphicsFamily;
+
                 return indices;
             }
 
@@ -535,15 +625,7 @@ namespace arx {
         }
 
         void ArxDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
-            VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-            VkBufferCopy copyRegion{};
-            copyRegion.srcOffset = srcOffset;
-            copyRegion.dstOffset = dstOffset;
-            copyRegion.size = size;
-            vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-            endSingleTimeCommands(commandBuffer);
+            _uploader->copyBuffer(srcBuffer, dstBuffer, size, srcOffset, dstOffset);
         }
 
 
@@ -577,6 +659,15 @@ namespace arx {
             vkDestroyBuffer(device(), buffer, nullptr);
         }
 
+        void ArxDevice::drawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkBuffer countBuffer, uint32_t maxDrawCount, uint32_t stride) {
+            if (maxDrawCount == 0) return;
+
+            if (drawIndirectCountSupported)
+                cmdDrawIndexedIndirectCount(commandBuffer, buffer, 0, countBuffer, 0, maxDrawCount, stride);
+            else
+                vkCmdDrawIndexedIndirect(commandBuffer, buffer, 0, maxDrawCount, stride);
+        }
+
         void ArxDevice::freeMemory(VkDeviceMemory memory) {
             vkFreeMemory(device(), memory, nullptr);
         }
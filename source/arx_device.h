@@ -5,6 +5,9 @@
 
 namespace arx {
 
+class ArxAllocator;
+class ArxUploader;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -14,8 +17,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t transferFamily; // Same as graphicsFamily unless the device has a family without graphics
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    bool transferFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -42,6 +47,12 @@ class ArxDevice {
     VkSurfaceKHR surface() { return _surface; }
     VkQueue graphicsQueue() { return _graphicsQueue; }
     VkQueue presentQueue() { return _presentQueue; }
+    // Graphics queue when there is no dedicated transfer family
+    VkQueue transferQueue() { return _transferQueue; }
+    // Every ArxBuffer and texture image is placed in here
+    ArxAllocator& allocator() { return *_allocator; }
+    // Batched staging uploads, prefer it over copyBuffer when nothing needs the data before the next commit
+    ArxUploader& uploader() { return *_uploader; }
 
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
@@ -49,6 +60,9 @@ class ArxDevice {
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
     VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkPhysicalDeviceProperties getProperties() { return properties; }
+    bool supportsDrawIndirectCount() const { return drawIndirectCountSupported; }
+    // Max and min sampler reduction on R32_SFLOAT
+    bool supportsSamplerFilterMinmax() const { return samplerFilterMinmaxSupported; }
 
     // Buffer Helper Functions
     void createBuffer(
@@ -58,10 +72,19 @@ class ArxDevice {
         VkBuffer &buffer,
         VkDeviceMemory &bufferMemory);
     VkCommandBuffer beginSingleTimeCommands();
+    // Blocks until the commands are done, they are not ordered against uploader batches
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    // Recorded into the uploader batch, see ArxUploader::commit
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
     void destroyBuffer(VkBuffer buffer);
+    // Draws as many commands as countBuffer holds, up to maxDrawCount. Without VK_KHR_draw_indirect_count all
+    // maxDrawCount commands are issued, the ones past the count have to be zero instance draws
+    void drawIndexedIndirectCount(VkCommandBuffer commandBuffer,
+                                  VkBuffer buffer,
+                                  VkBuffer countBuffer,
+                                  uint32_t maxDrawCount,
+                                  uint32_t stride);
     void freeMemory(VkDeviceMemory memory);
 
     void createImageWithInfo(
@@ -83,6 +106,9 @@ class ArxDevice {
         void pickPhysicalDevice();
         void setImagelessFramebufferFeature();
         void setBufferDeviceAddressFeature();
+        void setTimelineSemaphoreFeature();
+        void setDrawIndirectCountFeature();
+        void setSamplerFilterMinmaxFeature();
         void createLogicalDevice();
         void createCommandPool();
 
@@ -94,6 +120,7 @@ class ArxDevice {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool isDeviceExtensionAvailable(const char *extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
         VkSampleCountFlagBits getMaxUsableSampleCount();
 
@@ -104,7 +131,11 @@ class ArxDevice {
         VkCommandPool                                   commandPool;
         VkPhysicalDeviceImagelessFramebufferFeatures    imagelessFramebufferFeatures;
         VkPhysicalDeviceBufferDeviceAddressFeatures     bufferDeviceAddressFeatures;
+        VkPhysicalDeviceTimelineSemaphoreFeatures       timelineSemaphoreFeatures;
         bool                                            supportsBufferDeviceAddress;
+        bool                                            drawIndirectCountSupported = false;
+        bool                                            samplerFilterMinmaxSupported = false;
+        PFN_vkCmdDrawIndexedIndirectCountKHR            cmdDrawIndexedIndirectCount = nullptr;
 
         
         
@@ -114,6 +145,10 @@ class ArxDevice {
         VkSurfaceKHR  _surface;
         VkQueue       _graphicsQueue;
         VkQueue       _presentQueue;
+        VkQueue       _transferQueue;
+        
+        std::unique_ptr<ArxAllocator>   _allocator;
+        std::unique_ptr<ArxUploader>    _uploader;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -2,13 +2,10 @@
 
 #include "../source/arx_camera.h"
 #include "../source/arx_game_object.h"
+#include "../source/geometry/voxelTypes.hpp"
 
 namespace arx {
     
-static const int CHUNK_SIZE = 8;
-static const float VOXEL_SIZE = 0.5;
-static const int ADJUSTED_CHUNK = CHUNK_SIZE / VOXEL_SIZE;
-
 static const float SSAO_KERNEL_SIZE = 32;
 static const float SSAO_NOISE_DIM = 4;
 static const float SSAO_RADIUS = 0.7f;
@@ -0,0 +1,45 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/arx_frame_ring.h"
+
+namespace arx {
+
+    ArxFrameRing::ArxFrameRing(ArxDevice &device, uint32_t frameCount) : frameCount{frameCount} {
+        const auto& limits = device.getProperties().limits;
+        alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+
+        // Coherent so pushes never need a flush
+        buffer = std::make_unique<ArxBuffer>(device,
+                                             FRAME_SIZE,
+                                             frameCount,
+                                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             alignment);
+        buffer->map();
+        mapped = static_cast<uint8_t*>(buffer->getMappedMemory());
+
+        ARX_LOG_INFO("Frame ring: {} frames of {} KB, offsets aligned to {} bytes", frameCount, FRAME_SIZE / 1024, alignment);
+    }
+
+    void ArxFrameRing::beginFrame(uint32_t frameIndex) {
+        assert(frameIndex < frameCount && "Frame index out of range");
+        frameStart = frameIndex * FRAME_SIZE;
+        head = 0;
+    }
+
+    uint32_t ArxFrameRing::push(const void* data, VkDeviceSize size) {
+        assert(size <= FRAME_SIZE && "Push is larger than a frame's slice");
+
+        if (head + size > FRAME_SIZE) {
+            // Overwrites this frame's earliest pushes, FRAME_SIZE has to grow
+            ARX_LOG_ERROR("Frame ring slice of {} bytes overflowed", FRAME_SIZE);
+            head = 0;
+        }
+
+        const VkDeviceSize offset = frameStart + head;
+        std::memcpy(mapped + offset, data, size);
+        head = (head + size + alignment - 1) & ~(alignment - 1);
+
+        return static_cast<uint32_t>(offset);
+    }
+}
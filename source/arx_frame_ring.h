@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../source/arx_buffer.h"
+
+namespace arx {
+
+    // Linear allocator for data that lives one frame, uniforms mostly. One persistently mapped buffer is split
+    // into a slice per frame in flight, pushes bump a pointer through the current slice and return the offset
+    // to bind it at. Descriptors point at the ring once with a *_DYNAMIC type and get the offsets at bind time,
+    // so the CPU fills frame N+1 while the GPU still reads frame N without a map or a copy per buffer.
+    // The caller makes sure the GPU is done with a slice before beginFrame hands it out again
+    class ArxFrameRing {
+    public:
+        static constexpr VkDeviceSize FRAME_SIZE = 64 * 1024;
+
+        ArxFrameRing(ArxDevice &device, uint32_t frameCount);
+
+        ArxFrameRing(const ArxFrameRing&) = delete;
+        ArxFrameRing& operator=(const ArxFrameRing&) = delete;
+
+        // Rewinds to the start of the frame's slice
+        void beginFrame(uint32_t frameIndex);
+
+        // Copies data into the current slice, returns its dynamic offset
+        uint32_t push(const void* data, VkDeviceSize size);
+
+        template<typename T>
+        uint32_t push(const T& data) { return push(&data, sizeof(T)); }
+
+        // Descriptor for a dynamic binding, range is the size of the struct the shader reads
+        VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const { return {buffer->getBuffer(), 0, range}; }
+
+        VkDeviceSize getAlignment() const { return alignment; }
+
+    private:
+        std::unique_ptr<ArxBuffer>  buffer;
+        uint8_t*                    mapped = nullptr;
+        VkDeviceSize                alignment;
+        uint32_t                    frameCount;
+        VkDeviceSize                frameStart = 0;
+        VkDeviceSize                head = 0;    // Relative to frameStart
+    };
+}
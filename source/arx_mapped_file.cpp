@@ -0,0 +1,86 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/arx_mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace arx {
+
+    ArxMappedFile::~ArxMappedFile() {
+        close();
+    }
+
+    bool ArxMappedFile::open(const std::string& filepath, Access access) {
+        close();
+        
+        int fd = ::open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            ARX_LOG_ERROR("Failed to open {}", filepath);
+            return false;
+        }
+        
+        // st_size is 64 bit on every platform we ship, files over 4GB map fine
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ARX_LOG_ERROR("Failed to stat {} or the file is empty", filepath);
+            ::close(fd);
+            return false;
+        }
+        
+#ifdef __APPLE__
+        // Ask the kernel to start reading while we set up the mapping
+        if (access == Access::Sequential) {
+            fcntl(fd, F_RDAHEAD, 1);
+        }
+#endif
+        
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+        
+        if (address == MAP_FAILED) {
+            ARX_LOG_ERROR("Failed to map {}", filepath);
+            return false;
+        }
+        
+        mapped = address;
+        fileSize = static_cast<uint64_t>(info.st_size);
+        
+        posix_madvise(mapped, static_cast<size_t>(fileSize), access == Access::Sequential ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_RANDOM);
+        if (access == Access::Sequential) {
+            willNeed(0, fileSize);
+        }
+        
+        return true;
+    }
+
+    void ArxMappedFile::close() {
+        if (mapped) {
+            munmap(mapped, static_cast<size_t>(fileSize));
+            mapped = nullptr;
+            fileSize = 0;
+        }
+    }
+
+    void ArxMappedFile::willNeed(uint64_t offset, uint64_t length) const {
+        if (!mapped || offset >= fileSize) return;
+        
+        // madvise wants a page aligned start
+        const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        const uint64_t begin = offset & ~(pageSize - 1);
+        const uint64_t end = std::min(offset + length, fileSize);
+        posix_madvise(static_cast<uint8_t*>(mapped) + begin, static_cast<size_t>(end - begin), POSIX_MADV_WILLNEED);
+    }
+
+    void ArxMappedFile::dontNeed(uint64_t offset, uint64_t length) const {
+        if (!mapped || offset >= fileSize) return;
+        
+        const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        const uint64_t begin = offset & ~(pageSize - 1);
+        const uint64_t end = std::min(offset + length, fileSize);
+        posix_madvise(static_cast<uint8_t*>(mapped) + begin, static_cast<size_t>(end - begin), POSIX_MADV_DONTNEED);
+    }
+}
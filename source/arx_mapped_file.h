@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace arx {
+
+    // Read only memory mapping of a whole file, the pages are only read when touched
+    class ArxMappedFile {
+    public:
+        enum class Access {
+            Sequential, // Parsed front to back once, read ahead aggressively
+            Random
+        };
+        
+        ArxMappedFile() = default;
+        ~ArxMappedFile();
+        
+        ArxMappedFile(const ArxMappedFile&) = delete;
+        ArxMappedFile& operator=(const ArxMappedFile&) = delete;
+        
+        bool open(const std::string& filepath, Access access = Access::Sequential);
+        void close();
+        
+        // Hint that a range is about to be read, or is no longer needed
+        void willNeed(uint64_t offset, uint64_t length) const;
+        void dontNeed(uint64_t offset, uint64_t length) const;
+        
+        bool isOpen() const             { return mapped != nullptr; }
+        const uint8_t* data() const     { return static_cast<const uint8_t*>(mapped); }
+        uint64_t size() const           { return fileSize; }
+        
+    private:
+        void*       mapped = nullptr;
+        uint64_t    fileSize = 0;
+    };
+}
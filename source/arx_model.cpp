@@ -2,6 +2,8 @@
 
 #include "../source/arx_model.h"
 #include "../source/arx_utils.h"
+#include "../source/arx_uploader.h"
+#include "../source/geometry/occupancyGrid.hpp"
 
 // libs
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -27,57 +29,55 @@ namespace arx {
     uint32_t ArxModel::worldHeight      = 0;
     uint32_t ArxModel::worldDepth       = 0;
 
-    ArxModel::ArxModel(ArxDevice &device, const ArxModel::Builder &builder)
-    : arxDevice{device} {
-        createVertexBuffers(builder);
-        createIndexBuffers(builder.indices);
-        createInstanceBuffer(builder);
+    std::unordered_map<std::string, std::shared_ptr<const ArxModel::Mesh>> ArxModel::meshCache;
+
+    ArxModel::ArxModel(ArxDevice &device, std::shared_ptr<const Mesh> mesh, uint32_t instanceCount, const std::vector<PackedInstance> &data)
+    : arxDevice{device}, mesh{std::move(mesh)}, instanceCount{instanceCount} {
+        createInstanceBuffer(data);
         
         totalInstances += instanceCount;
     }
 
     ArxModel::~ArxModel() {}
 
-    std::unique_ptr<ArxModel> ArxModel::createModelFromFile(ArxDevice &device, const std::string &filepath, uint32_t instanceCount, const std::vector<InstanceData> &data) {
+    std::unique_ptr<ArxModel> ArxModel::createModelFromFile(ArxDevice &device, const std::string &filepath, uint32_t instanceCount, const std::vector<PackedInstance> &data) {
+        return std::make_unique<ArxModel>(device, loadMesh(device, filepath), instanceCount, data);
+    }
+
+    std::shared_ptr<const ArxModel::Mesh> ArxModel::loadMesh(ArxDevice &device, const std::string &filepath) {
+        if (auto it = meshCache.find(filepath); it != meshCache.end())
+            return it->second;
         
         Builder builder{};
-        builder.instanceCount = instanceCount;
         builder.loadModel(filepath);
-        builder.instanceData = data;
+        builder.groupTrianglesByFace();
+        
+        auto mesh = std::make_shared<Mesh>();
+        mesh->vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        mesh->vertexBuffer = createVertexBuffer(device, builder.vertices);
+        mesh->indexCount = static_cast<uint32_t>(builder.indices.size());
+        if (mesh->indexCount > 0)
+            mesh->indexBuffer = createIndexBuffer(device, builder.indices);
         
-        calculateWorldDimensions(data);
-       
-        return std::make_unique<ArxModel>(device, builder);
+        meshCache.emplace(filepath, mesh);
+        return mesh;
     }
 
-    void ArxModel::createVertexBuffers(const ArxModel::Builder &builder) {
-        vertexCount = static_cast<uint32_t>(builder.vertices.size());
+    std::shared_ptr<ArxBuffer> ArxModel::createVertexBuffer(ArxDevice &device, const std::vector<Vertex> &vertices) {
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
         assert(vertexCount >= 3 && "Vertex count must be at least 3");
-        VkDeviceSize bufferSize = sizeof(builder.vertices[0]) * vertexCount;
-        uint32_t vertexSize = sizeof(builder.vertices[0]);
-        
-        auto stagingBuffer = std::make_shared<ArxBuffer>(
-                   arxDevice,
-                   vertexSize,
-                   vertexCount,
-                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-               );
-        
-        stagingBuffer->map();
-        stagingBuffer->writeToBuffer((void *)builder.vertices.data());
-        
+        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+        uint32_t vertexSize = sizeof(vertices[0]);
         
-        vertexBuffer = std::make_shared<ArxBuffer>(
-                                                   arxDevice,
+        auto vertexBuffer = std::make_shared<ArxBuffer>(
+                                                   device,
                                                    vertexSize,
                                                    vertexCount,
                                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
         
-        arxDevice.copyBuffer(stagingBuffer->getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        device.uploader().uploadBuffer(vertexBuffer->getBuffer(), vertices.data(), bufferSize);
         
         // Calculate and register offset
         VkDeviceSize vertexBufferOffset = 0;
@@ -85,33 +85,17 @@ namespace arx {
            vertexBufferOffset += buffer->getBufferSize();
             
         }
-        BufferManager::addVertexBuffer(stagingBuffer, vertexBufferOffset);
+        BufferManager::addVertexBuffer(vertexBuffer, vertexBufferOffset);
+        return vertexBuffer;
     }
 
-    void ArxModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffer = indexCount > 0;
-
-        if (!hasIndexBuffer)
-            return;
-
+    std::shared_ptr<ArxBuffer> ArxModel::createIndexBuffer(ArxDevice &device, const std::vector<uint32_t> &indices) {
+        uint32_t indexCount = static_cast<uint32_t>(indices.size());
         VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
         uint32_t indexSize = sizeof(indices[0]);
 
-        auto stagingBuffer = std::make_shared<ArxBuffer>(
-                 arxDevice,
-                 indexSize,
-                 indexCount,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-             );
-
-        stagingBuffer->map();
-        stagingBuffer->writeToBuffer((void *)indices.data());
-
-        indexBuffer = std::make_shared<ArxBuffer>(
-            arxDevice,
+        auto indexBuffer = std::make_shared<ArxBuffer>(
+            device,
             indexSize,
             indexCount,
             VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
@@ -119,47 +103,36 @@ namespace arx {
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        arxDevice.copyBuffer(stagingBuffer->getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        device.uploader().uploadBuffer(indexBuffer->getBuffer(), indices.data(), bufferSize);
 
         // Calculate and register offset
         VkDeviceSize indexBufferOffset = 0;
         for (const auto& buffer : BufferManager::indexBuffers) {
             indexBufferOffset += buffer->getBufferSize();
         }
-        BufferManager::addIndexBuffer(stagingBuffer, indexBufferOffset);
+        BufferManager::addIndexBuffer(indexBuffer, indexBufferOffset);
+        return indexBuffer;
     }
 
 
-    void ArxModel::createInstanceBuffer(const ArxModel::Builder &builder) {
-        VkDeviceSize instanceBufferSize = builder.instanceCount * sizeof(InstanceData);
-        
-        uint64_t instanceSize = sizeof(InstanceData);
-        instanceCount = builder.instanceCount;
+    void ArxModel::createInstanceBuffer(const std::vector<PackedInstance> &data) {
+        uint64_t instanceSize = sizeof(PackedInstance);
 
-        auto instanceStagingBuffer = std::make_shared<ArxBuffer>(
+        // The G-pass reads every chunk's instances out of BufferManager::largeInstanceBuffer, this copy source
+        // is dropped together with every other chunk's once that buffer is committed, so they share linear blocks
+        auto instanceBuffer = std::make_shared<ArxBuffer>(
             arxDevice,
             instanceSize,
             instanceCount,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            1,
+            ArxAllocator::Strategy::Linear
         );
 
-        instanceStagingBuffer->map();
-        instanceStagingBuffer->writeToBuffer((void*)builder.instanceData.data());
-
-        instanceBuffer = std::make_shared<ArxBuffer>(
-            arxDevice,
-            instanceSize,
-            instanceCount,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        arxDevice.copyBuffer(instanceStagingBuffer->getBuffer(), instanceBuffer->getBuffer(), instanceBufferSize);
+        instanceBuffer->map();
+        instanceBuffer->writeToBuffer((void*)data.data());
 
         // Calculate and register offset
         uint32_t instanceBufferOffset = 0;
@@ -167,26 +140,26 @@ namespace arx {
             instanceBufferOffset += buffer->getBufferSize();
         }
             
-        BufferManager::addInstanceBuffer(instanceStagingBuffer, instanceBufferOffset);
+        BufferManager::addInstanceBuffer(instanceBuffer, instanceBufferOffset);
     }
 
     // Not using it anymore, used it for instanced rendering
     void ArxModel::draw(VkCommandBuffer commandBuffer) {
-        if (hasIndexBuffer) {
-            vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+        if (mesh->indexBuffer) {
+            vkCmdDrawIndexed(commandBuffer, mesh->indexCount, instanceCount, 0, 0, 0);
         }
         else {
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, mesh->vertexCount, 1, 0, 0);
         }
     }
     
     void ArxModel::bind(VkCommandBuffer commandBuffer) {
-        VkBuffer buffers[]      = {vertexBuffer->getBuffer()};
+        VkBuffer buffers[]      = {mesh->vertexBuffer->getBuffer()};
         VkDeviceSize offsets[]  = {0};
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
         
-        if (hasIndexBuffer) {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        if (mesh->indexBuffer) {
+            vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
         }
     }
 
@@ -267,14 +240,28 @@ namespace arx {
 //        std::cout << "\n";
     }
     
-    void ArxModel::calculateWorldDimensions(const std::vector<InstanceData> &instanceData) {
-        if (instanceData.empty()) {
-            return;
+    void ArxModel::Builder::groupTrianglesByFace() {
+        auto faceOf = [this](size_t triangle) {
+            const glm::vec3 normal = vertices[indices[triangle * 3]].normal;
+            const glm::vec3 absNormal = glm::abs(normal);
+            if (absNormal.x >= absNormal.y && absNormal.x >= absNormal.z) return normal.x > 0 ? FACE_POS_X : FACE_NEG_X;
+            if (absNormal.y >= absNormal.z)                                return normal.y > 0 ? FACE_POS_Y : FACE_NEG_Y;
+            return normal.z > 0 ? FACE_POS_Z : FACE_NEG_Z;
+        };
+        
+        std::vector<size_t> triangles(indices.size() / 3);
+        std::iota(triangles.begin(), triangles.end(), 0);
+        std::stable_sort(triangles.begin(), triangles.end(), [&](size_t a, size_t b) { return faceOf(a) < faceOf(b); });
+        
+        std::vector<uint32_t> sorted;
+        sorted.reserve(indices.size());
+        for (size_t triangle : triangles) {
+            sorted.insert(sorted.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
         }
-
-        // Assuming the last value has the maximum dimensions
-        glm::vec4 lastTranslation = instanceData.back().translation;
-
+        indices = std::move(sorted);
+    }
+    
+    void ArxModel::calculateWorldDimensions(const glm::vec3 &lastTranslation) {
         uint32_t newWidth = static_cast<uint32_t>(lastTranslation.x);
         uint32_t newHeight = static_cast<uint32_t>(std::abs(lastTranslation.y));
         uint32_t newDepth = static_cast<uint32_t>(lastTranslation.z);
@@ -28,17 +28,29 @@ namespace arx {
         struct Builder {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
-            
-            std::vector<InstanceData> instanceData{};
-            uint32_t instanceCount{};
 
             void loadModel(const std::string &filepath);
+            // Stable sorts the triangles by the VoxelFace their normal points along. The instanced cube is drawn
+            // one face direction at a time, face f being the 6 indices at f * 6
+            void groupTrianglesByFace();
+        };
+        
+        // Device local vertex and index buffers of one model file, shared by every ArxModel created from it
+        struct Mesh {
+            std::shared_ptr<ArxBuffer>  vertexBuffer;
+            uint32_t                    vertexCount{0};
+            std::shared_ptr<ArxBuffer>  indexBuffer;
+            uint32_t                    indexCount{0};
         };
         
-        ArxModel(ArxDevice &device, const ArxModel::Builder &builder);
+        ArxModel(ArxDevice &device, std::shared_ptr<const Mesh> mesh, uint32_t instanceCount, const std::vector<PackedInstance> &data);
         ~ArxModel();
         
-        static std::unique_ptr<ArxModel> createModelFromFile(ArxDevice &device, const std::string &filepath, uint32_t instanceCount = 1, const std::vector<InstanceData> &data = {});
+        // The file is parsed and uploaded on first use only, later models reuse its Mesh
+        static std::unique_ptr<ArxModel> createModelFromFile(ArxDevice &device, const std::string &filepath, uint32_t instanceCount = 1, const std::vector<PackedInstance> &data = {});
+        static std::shared_ptr<const Mesh> loadMesh(ArxDevice &device, const std::string &filepath);
+        // Models keep their Mesh alive, this only drops the cache's references
+        static void clearMeshCache() { meshCache.clear(); }
         
         ArxModel(const ArxModel &) = delete;
         ArxModel &operator=(const ArxModel &) = delete;
@@ -46,35 +58,31 @@ namespace arx {
         void bind(VkCommandBuffer commandBuffer);
         void draw(VkCommandBuffer commandBuffer);
         
-        uint32_t getIndexCount() { return indexCount; }
+        uint32_t getIndexCount() { return mesh->indexCount; }
         uint32_t getInstanceCount() { return instanceCount; }
         
         static uint32_t getWorldWidth() { return worldWidth; }
         static uint32_t getWorldHeight() { return worldHeight; }
         static uint32_t getWorldDepth() { return worldDepth; }
         static uint32_t getTotalInstances() { return totalInstances; }
+        // Grows the world dimensions to cover the last (furthest) translation of a chunk
+        static void calculateWorldDimensions(const glm::vec3 &lastTranslation);
         
     private:
-        void createVertexBuffers(const ArxModel::Builder &builder);
-        void createIndexBuffers(const std::vector<uint32_t> &indices);
-        void createInstanceBuffer(const ArxModel::Builder &builder);
-        static void calculateWorldDimensions(const std::vector<InstanceData> &instanceData);
+        static std::shared_ptr<ArxBuffer> createVertexBuffer(ArxDevice &device, const std::vector<Vertex> &vertices);
+        static std::shared_ptr<ArxBuffer> createIndexBuffer(ArxDevice &device, const std::vector<uint32_t> &indices);
+        void createInstanceBuffer(const std::vector<PackedInstance> &data);
         
         ArxDevice                   &arxDevice;
         
-        std::shared_ptr<ArxBuffer>  vertexBuffer;
-        uint32_t                    vertexCount;
+        std::shared_ptr<const Mesh> mesh;
         
-        std::shared_ptr<ArxBuffer>  instanceBuffer;
         uint32_t                    instanceCount;
         static uint32_t             totalInstances;
         static uint32_t             worldWidth;
         static uint32_t             worldHeight;
         static uint32_t             worldDepth;
         
-        
-        bool                        hasIndexBuffer = false;
-        std::shared_ptr<ArxBuffer>  indexBuffer;
-        uint32_t                    indexCount;
+        static std::unordered_map<std::string, std::shared_ptr<const Mesh>> meshCache; // Keyed by file path
     };
 }
@@ -2,6 +2,7 @@
 
 #include "../source/arx_frame_info.h"
 #include "../source/arx_renderer.h"
+#include "../source/arx_uploader.h"
 #include "../source/geometry/chunks.h"
 #include "../source/systems/clustered_shading_system.hpp"
 
@@ -96,6 +97,9 @@ namespace arx {
         
         isFrameStarted = true;
         
+        // acquireNextImage waited on this frame's fence, the GPU is done with its ring slice
+        BufferManager::frameRing->beginFrame(currentFrameIndex);
+        
         auto commandBuffer = getCurrentCommandBuffer();
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType     = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -104,6 +108,9 @@ namespace arx {
             ARX_LOG_ERROR("failed to begin recording commnad buffer!");
         }
         
+        // Uploads that finished on the transfer queue since last frame become readable from here on
+        uploadWaitValue = arxDevice.uploader().acquire(commandBuffer);
+        
         return commandBuffer;
     }
 
@@ -114,7 +121,7 @@ namespace arx {
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             ARX_LOG_ERROR("failed to record command buffer!");
         }
-        auto result = arxSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+        auto result = arxSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, uploadWaitValue);
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || arxWindow.wasWindowResized()) {
             arxWindow.resetWindowResizedFlag();
             recreateSwapChain();
@@ -50,6 +50,8 @@ namespace arx {
         
         void updateUniforms(const GlobalUbo &rhs, const CompositionParams &ssaorhs);
         void cleanupResources();
+        // Points frameIndex's deferred set at Materials::pointLightBuffers[frameIndex] again, after flush replaced it
+        void updateLightBuffer(uint32_t frameIndex);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities, VkExtent2D windowExtent);
     private:
         void createCommandBuffers();
@@ -74,11 +76,18 @@ namespace arx {
         std::vector<VkCommandBuffer>    commandBuffers;
         
         uint32_t                        currentImageIndex;
+        uint64_t                        uploadWaitValue = 0;
         int                             currentFrameIndex{0};
         bool                            isFrameStarted = false;
         bool                            hasResized = false;
         
         GlobalUbo                       ubo{};
         CompositionParams               compParams{};
+        
+        // This frame's uniforms in BufferManager::frameRing, bound as dynamic offsets
+        uint32_t                        uboOffset = 0;
+        uint32_t                        compParamsOffset = 0;
+        uint32_t                        frustumOffset = 0;
+        uint32_t                        editorOffset = 0;
     };
 }
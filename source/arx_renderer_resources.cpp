@@ -9,6 +9,7 @@
 
 #include "../source/systems/clustered_shading_system.hpp"
 #include "../source/geometry/blockMaterials.hpp"
+#include "../source/editor/profiling/arx_profiler.hpp"
 
 namespace arx {
 
@@ -37,13 +38,19 @@ namespace arx {
         std::array<std::shared_ptr<ArxPipeline>, static_cast<uint8_t>(PassName::Max)>                           pipelines;
     
         std::unordered_map<uint8_t, std::vector<std::shared_ptr<ArxBuffer>>>                                    passBuffers;
+    
+        // G-Pass variant for greedy meshed chunks, shares the G-Pass layout and descriptors
+        std::shared_ptr<ArxPipeline>                                                                            gPassMeshPipeline;
     }
 
     void ArxRenderer::createDescriptorSetLayouts() {
         // G-Buffer
         descriptorLayouts[static_cast<uint8_t>(PassName::GPass)].push_back(ArxDescriptorSetLayout::Builder(arxDevice)
-                                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS) // InstanceBuffer
+                                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS) // InstanceBuffer
                                         .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // UBO
+                                        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // ChunkOriginBuffer
+                                        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // PaletteBuffer
+                                        .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // MeshVertexBuffer
                                         .build());
         
         // SSAO
@@ -52,7 +59,7 @@ namespace arx {
                                         .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // samplerNormal
                                         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // ssaoNoise
                                         .addBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // UBOSSAOKernel
-                                        .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
+                                        .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
                                         .build());
         
         // SSAOBlur
@@ -67,12 +74,13 @@ namespace arx {
                                         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // samplerAlbedo
                                         .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // LTC1
                                         .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // LTC2
-                                        .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
+                                        .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
                                         .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // PointLightsBuffer
                                         .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Cluster Lights
                                         .addBinding(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // lightCount
-                                        .addBinding(9, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Frustum params
-                                        .addBinding(10, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Editor Params
+                                        .addBinding(9, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // Frustum params
+                                        .addBinding(10, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // Editor Params
+                                        .addBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Light index list
                                         .build());
         
         // Composition
@@ -83,8 +91,8 @@ namespace arx {
                                         .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // samplerSSAO
                                         .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // samplerSSAOBlur
                                         .addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // samplerDeferred
-                                        .addBinding(6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
-                                        .addBinding(7, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // Editor Params
+                                        .addBinding(6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // UBO
+                                        .addBinding(7, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT) // Editor Params
                                         .build());
 
         // ImGUI
@@ -236,6 +244,14 @@ namespace arx {
                                                                                         "shaders/gbuffer_frag.spv",
                                                                                         "",
                                                                                          gPassConfigInfo);
+        
+        // Meshed chunks pull their vertices from the mesh vertex buffer
+        gPassConfigInfo.useVertexInputState = false;
+        gPassMeshPipeline = std::make_shared<ArxPipeline>(arxDevice,
+                                                          "shaders/gbuffer_mesh_vert.spv",
+                                                          "shaders/gbuffer_frag.spv",
+                                                          "",
+                                                          gPassConfigInfo);
 
         // ====================================================================================
         //                                    COMPOSITION
@@ -390,32 +406,33 @@ namespace arx {
         
         descriptorPools[static_cast<uint8_t>(PassName::GPass)] = ArxDescriptorPool::Builder(arxDevice)
                                                                        .setMaxSets(1)
-                                                                       .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f)
-                                                                       .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f)
+                                                                       .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f)
+                                                                       .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.f)
                                                                        .build();
 
-        passBuffers[static_cast<uint8_t>(PassName::GPass)].push_back(std::make_shared<ArxBuffer>(
-                                                                     arxDevice,
-                                                                     sizeof(GlobalUbo),
-                                                                     1,
-                                                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
-
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->writeToBuffer(&ubo);
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->unmap();
+        // Per-frame uniforms live in the frame ring, offsets come with every bind
+        auto& frameRing = *BufferManager::frameRing;
         
         passBuffers[static_cast<uint8_t>(PassName::GPass)].push_back(BufferManager::largeInstanceBuffer);
+        passBuffers[static_cast<uint8_t>(PassName::GPass)].push_back(BufferManager::chunkOriginBuffer);
+        passBuffers[static_cast<uint8_t>(PassName::GPass)].push_back(BufferManager::paletteBuffer);
+        passBuffers[static_cast<uint8_t>(PassName::GPass)].push_back(BufferManager::meshVertexBuffer);
     
         descriptorSets[static_cast<uint8_t>(PassName::GPass)].resize(1);
 
-        auto bufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->descriptorInfo();
-        auto instanceBufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][1]->descriptorInfo();
+        auto bufferInfo = frameRing.descriptorInfo(sizeof(GlobalUbo));
+        auto instanceBufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->descriptorInfo();
+        auto chunkOriginBufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][1]->descriptorInfo();
+        auto paletteBufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][2]->descriptorInfo();
+        auto meshVertexBufferInfo = passBuffers[static_cast<uint8_t>(PassName::GPass)][3]->descriptorInfo();
 
         ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::GPass)][0],
                            *descriptorPools[static_cast<uint8_t>(PassName::GPass)])
                            .writeBuffer(0, &bufferInfo)
                            .writeBuffer(1, &instanceBufferInfo)
+                           .writeBuffer(2, &chunkOriginBufferInfo)
+                           .writeBuffer(3, &paletteBufferInfo)
+                           .writeBuffer(4, &meshVertexBufferInfo)
                            .build(descriptorSets[static_cast<uint8_t>(PassName::GPass)][0]);
         
         // ====================================================================================
@@ -425,7 +442,8 @@ namespace arx {
         descriptorPools[static_cast<uint8_t>(PassName::SSAO)] = ArxDescriptorPool::Builder(arxDevice)
                                                                 .setMaxSets(1)
                                                                 .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3.0f)
-                                                                .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f)
+                                                                .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f)
+                                                                .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f)
                                                                 .build();
         // Sampler Position Depth
         VkDescriptorImageInfo samplerPosDepthInfo{};
@@ -490,22 +508,10 @@ namespace arx {
         ssaoNoiseInfo.imageView = textureManager.getTexture("ssaoNoise")->view;
         ssaoNoiseInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        // SSAO Params
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)].push_back(std::make_shared<ArxBuffer>(
-                                                                        arxDevice,
-                                                                        sizeof(CompositionParams),
-                                                                        1,
-                                                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->map();
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->writeToBuffer(&compParams);
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->unmap();
-        
         descriptorSets[static_cast<uint8_t>(PassName::SSAO)].resize(1);
         
         auto ssaoKernelInfo = passBuffers[static_cast<uint8_t>(PassName::SSAO)][0]->descriptorInfo();
-        auto ssaoParamsInfo = passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->descriptorInfo();
+        auto ssaoParamsInfo = frameRing.descriptorInfo(sizeof(CompositionParams));
         
         ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::SSAO)][0],
                             *descriptorPools[static_cast<uint8_t>(PassName::SSAO)])
@@ -541,11 +547,14 @@ namespace arx {
         //                                     Deferred
         // ====================================================================================
         
+        // One set per frame in flight, the cluster light lists are rebuilt every frame
+        constexpr uint32_t frames = BufferManager::MAX_FRAMES_IN_FLIGHT;
         descriptorPools[static_cast<uint8_t>(PassName::DEFERRED)] = ArxDescriptorPool::Builder(arxDevice)
-                                                                    .setMaxSets(1)
-                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5.0f)
-                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4.0f)
-                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f)
+                                                                    .setMaxSets(frames)
+                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5 * frames)
+                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames)
+                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3 * frames)
+                                                                    .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frames)
                                                                     .build();
         
         VkDescriptorImageInfo samplerAlbedoInfo{};
@@ -553,19 +562,6 @@ namespace arx {
         samplerAlbedoInfo.imageView = textureManager.getAttachment("gAlbedo")->view;
         samplerAlbedoInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(std::make_shared<ArxBuffer>(
-                                                                     arxDevice,
-                                                                     sizeof(GlobalUbo),
-                                                                     1,
-                                                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
-        
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->writeToBuffer(&ubo);
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->unmap();
-        
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(Materials::pointLightBuffer);
-        
         passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(std::make_shared<ArxBuffer>(
                                                                     arxDevice,
                                                                     sizeof(uint32_t),
@@ -573,20 +569,9 @@ namespace arx {
                                                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                                                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
         
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][2]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][2]->writeToBuffer(&Materials::maxPointLights);
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][2]->unmap();
-        
-        
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(ClusteredShading::clusterLightsBuffer);
-        
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(std::make_shared<ArxBuffer>(
-                                                                    arxDevice,
-                                                                    sizeof(ClusteredShading::Frustum),
-                                                                    1,
-                                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
-//        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][4]->map();
+        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->map();
+        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->writeToBuffer(&Materials::maxPointLights);
+        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->unmap();
         
         // Create the texture using the LTC1 data
         textureManager.createTexture2DFromBuffer(
@@ -624,37 +609,35 @@ namespace arx {
         samplerLTC2Info.imageView = textureManager.getTexture("LTC2_Texture")->view;
         samplerLTC2Info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)].push_back(Editor::editorDataBuffer);
-
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->writeToBuffer(&Editor::data);
+        auto uboInfo            = frameRing.descriptorInfo(sizeof(GlobalUbo));
+        auto lightCountInfo     = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->descriptorInfo();
+        auto frustumInfo        = frameRing.descriptorInfo(sizeof(ClusteredShading::Frustum));
+        auto editorInfo         = frameRing.descriptorInfo(sizeof(Editor::EditorImGuiData));
         
+        descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)].resize(frames);
         
-        auto uboInfo            = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->descriptorInfo();
-        VkDescriptorBufferInfo pointLightInfo{};
-        if (Materials::maxPointLights > 0)
-            pointLightInfo      = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][1]->descriptorInfo();
-        auto lightCountInfo     = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][2]->descriptorInfo();
-        auto clusterInfo        = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][3]->descriptorInfo();
-        auto frustumInfo        = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][4]->descriptorInfo();
-        auto editorInfo         = passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->descriptorInfo();
-        
-        descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)].resize(1);
-        
-        ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::DEFERRED)][0],
-                            *descriptorPools[static_cast<uint8_t>(PassName::DEFERRED)])
-                            .writeImage(0, &samplerPosDepthInfo)
-                            .writeImage(1, &samplerNormalInfo)
-                            .writeImage(2, &samplerAlbedoInfo)
-                            .writeImage(3, &samplerLTC1Info)
-                            .writeImage(4, &samplerLTC2Info)
-                            .writeBuffer(5, &uboInfo)
-                            .writeBuffer(6, &pointLightInfo)
-                            .writeBuffer(7, &clusterInfo)
-                            .writeBuffer(8, &lightCountInfo)
-                            .writeBuffer(9, &frustumInfo)
-                            .writeBuffer(10, &editorInfo)
-                            .build(descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)][0]);
+        for (uint32_t i = 0; i < frames; i++) {
+            auto clusterInfo = ClusteredShading::clusterLightsBuffers[i]->descriptorInfo();
+            auto lightIndexInfo = ClusteredShading::lightIndexBuffers[i]->descriptorInfo();
+            // Lights are edited on the CPU, each frame reads the copy its own flush wrote
+            auto pointLightInfo = Materials::pointLightBuffers[i]->descriptorInfo();
+            
+            ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::DEFERRED)][0],
+                                *descriptorPools[static_cast<uint8_t>(PassName::DEFERRED)])
+                                .writeImage(0, &samplerPosDepthInfo)
+                                .writeImage(1, &samplerNormalInfo)
+                                .writeImage(2, &samplerAlbedoInfo)
+                                .writeImage(3, &samplerLTC1Info)
+                                .writeImage(4, &samplerLTC2Info)
+                                .writeBuffer(5, &uboInfo)
+                                .writeBuffer(6, &pointLightInfo)
+                                .writeBuffer(7, &clusterInfo)
+                                .writeBuffer(8, &lightCountInfo)
+                                .writeBuffer(9, &frustumInfo)
+                                .writeBuffer(10, &editorInfo)
+                                .writeBuffer(11, &lightIndexInfo)
+                                .build(descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)][i]);
+        }
         
         // ====================================================================================
         //                                    COMPOSITION
@@ -663,7 +646,7 @@ namespace arx {
         descriptorPools[static_cast<uint8_t>(PassName::COMPOSITION)] = ArxDescriptorPool::Builder(arxDevice)
                                                                 .setMaxSets(1)
                                                                 .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6.0f)
-                                                                .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f)
+                                                                .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.0f)
                                                                 .build();
         
         VkDescriptorImageInfo samplerSSAOBlurColorInfo{};
@@ -676,26 +659,6 @@ namespace arx {
         samplerDeferredColorInfo.imageView = textureManager.getAttachment("deferredShading")->view;
         samplerDeferredColorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)].push_back(std::make_shared<ArxBuffer>(
-                                                                        arxDevice,
-                                                                        sizeof(CompositionParams),
-                                                                        1,
-                                                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
-        
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->writeToBuffer(&compParams);
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->unmap();
-
-
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)].push_back(Editor::editorDataBuffer);
-        
-        // Shared buffer already mapped
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][1]->writeToBuffer(&Editor::data);
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][1]->unmap();
-        
-        
         descriptorSets[static_cast<uint8_t>(PassName::COMPOSITION)].resize(1);
         
         ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::COMPOSITION)][0],
@@ -734,6 +697,15 @@ namespace arx {
                             .build(descriptorSets[static_cast<uint8_t>(PassName::IMGUI)][0]);
     }
 
+    void ArxRenderer::updateLightBuffer(uint32_t frameIndex) {
+        auto pointLightInfo = Materials::pointLightBuffers[frameIndex]->descriptorInfo();
+        
+        ArxDescriptorWriter(*descriptorLayouts[static_cast<uint8_t>(PassName::DEFERRED)][0],
+                            *descriptorPools[static_cast<uint8_t>(PassName::DEFERRED)])
+                            .writeBuffer(6, &pointLightInfo)
+                            .overwrite(descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)][frameIndex]);
+    }
+
     void ArxRenderer::cleanupResources() {
         for (VkPipelineLayout layout : pipelineLayouts) {
             if (layout != VK_NULL_HANDLE) {
@@ -761,6 +733,7 @@ namespace arx {
 
         pipelines[static_cast<uint8_t>(PassName::COMPOSITION)].reset();
         pipelines[static_cast<uint8_t>(PassName::GPass)].reset();
+        gPassMeshPipeline.reset();
         
         // Manually set the vertex shader module to nullptr to skip the destruction
         // These pipelines are using the fullscreen vertex shader of COMPOSITION
@@ -835,10 +808,13 @@ namespace arx {
             
             dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
             dependencies[0].dstSubpass = 0;
-            dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            // Frames overlap, so the previous frame's deferred pass and depth pyramid may still read the attachments
+            dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                           VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
             dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
             dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
             
             dependencies[1].srcSubpass = 0;
@@ -1146,7 +1122,14 @@ namespace arx {
 
         beginRenderPass(frameInfo.commandBuffer, "GBuffer");
         
-        pipelines[static_cast<uint8_t>(PassName::GPass)]->bind(frameInfo.commandBuffer);
+        // The draw commands were laid out by the culling pass for this mode
+        const bool greedyMeshing = arxSwapChain->cull->miscData.greedyMeshing;
+        
+        if (greedyMeshing) {
+            gPassMeshPipeline->bind(frameInfo.commandBuffer);
+        } else {
+            pipelines[static_cast<uint8_t>(PassName::GPass)]->bind(frameInfo.commandBuffer);
+        }
     
         vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -1154,10 +1137,14 @@ namespace arx {
                                 0,
                                 1,
                                 &descriptorSets[static_cast<uint8_t>(PassName::GPass)][0],
-                                0,
-                                nullptr);
+                                1,
+                                &uboOffset);
         
-        frameInfo.voxel[0].model->bind(frameInfo.commandBuffer);
+        if (greedyMeshing) {
+            vkCmdBindIndexBuffer(frameInfo.commandBuffer, BufferManager::meshIndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        } else {
+            frameInfo.voxel[0].model->bind(frameInfo.commandBuffer);
+        }
         
         PushConstantData push{};
 
@@ -1173,15 +1160,12 @@ namespace arx {
                            sizeof(PushConstantData),
                            &push);
         
-        uint32_t drawCount = BufferManager::readDrawCommandCount();
-        
-        if (drawCount > 0) {
-            vkCmdDrawIndexedIndirect(frameInfo.commandBuffer,
-                                     BufferManager::drawIndirectBuffer->getBuffer(),
-                                     0,
-                                     drawCount,
-                                     sizeof(GPUIndirectDrawCommand));
-        }
+        // The count comes straight from this frame's early cull
+        arxDevice.drawIndexedIndirectCount(frameInfo.commandBuffer,
+                                           BufferManager::drawIndirectBuffers[frameInfo.frameIndex]->getBuffer(),
+                                           BufferManager::drawCommandCountBuffers[frameInfo.frameIndex]->getBuffer(),
+                                           static_cast<uint32_t>(BufferManager::indirectDrawData.size()),
+                                           sizeof(GPUIndirectDrawCommand));
         
         vkCmdEndRenderPass(frameInfo.commandBuffer);
         Profiler::stopStageTimer("G-Pass", Profiler::Type::GPU, frameInfo.commandBuffer);
@@ -1202,8 +1186,8 @@ namespace arx {
                                     0,
                                     1,
                                     &descriptorSets[static_cast<uint8_t>(PassName::SSAO)][0],
-                                    0,
-                                    nullptr);
+                                    1,
+                                    &compParamsOffset);
             
             vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
             vkCmdEndRenderPass(frameInfo.commandBuffer);
@@ -1241,11 +1225,11 @@ namespace arx {
         
         if (compParams.deferred) {
             Profiler::startStageTimer("FrustumCluster", Profiler::Type::GPU, frameInfo.commandBuffer);
-            ClusteredShading::dispatchComputeFrustumCluster(frameInfo.commandBuffer);
+            ClusteredShading::dispatchComputeFrustumCluster(frameInfo.commandBuffer, frameInfo.frameIndex);
             Profiler::stopStageTimer("FrustumCluster", Profiler::Type::GPU, frameInfo.commandBuffer);
 
             Profiler::startStageTimer("CullLights", Profiler::Type::GPU, frameInfo.commandBuffer);
-            ClusteredShading::dispatchComputeClusterCulling(frameInfo.commandBuffer);
+            ClusteredShading::dispatchComputeClusterCulling(frameInfo.commandBuffer, frameInfo.frameIndex);
             Profiler::stopStageTimer("CullLights", Profiler::Type::GPU, frameInfo.commandBuffer);
 
             Profiler::startStageTimer("Deferred Shading", Profiler::Type::GPU, frameInfo.commandBuffer);
@@ -1253,14 +1237,16 @@ namespace arx {
             
             pipelines[static_cast<uint8_t>(PassName::DEFERRED)]->bind(frameInfo.commandBuffer);
             
+            // Binding order: UBO, frustum params, editor params
+            const uint32_t deferredOffsets[] = {uboOffset, frustumOffset, editorOffset};
             vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                                     VK_PIPELINE_BIND_POINT_GRAPHICS,
                                     pipelineLayouts[static_cast<uint8_t>(PassName::DEFERRED)],
                                     0,
                                     1,
-                                    &descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)][0],
-                                    0,
-                                    nullptr);
+                                    &descriptorSets[static_cast<uint8_t>(PassName::DEFERRED)][frameInfo.frameIndex],
+                                    static_cast<uint32_t>(std::size(deferredOffsets)),
+                                    deferredOffsets);
             
             vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
             vkCmdEndRenderPass(frameInfo.commandBuffer);
@@ -1276,14 +1262,15 @@ namespace arx {
         
         pipelines[static_cast<uint8_t>(PassName::COMPOSITION)]->bind(frameInfo.commandBuffer);
     
+        const uint32_t compositionOffsets[] = {compParamsOffset, editorOffset};
         vkCmdBindDescriptorSets(frameInfo.commandBuffer,
                                 VK_PIPELINE_BIND_POINT_GRAPHICS,
                                 pipelineLayouts[static_cast<uint8_t>(PassName::COMPOSITION)],
                                 0,
                                 1,
                                 &descriptorSets[static_cast<uint8_t>(PassName::COMPOSITION)][0],
-                                0,
-                                nullptr);
+                                static_cast<uint32_t>(std::size(compositionOffsets)),
+                                compositionOffsets);
         
         vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
         endSwapChainRenderPass(frameInfo.commandBuffer);
@@ -1317,12 +1304,11 @@ namespace arx {
         ubo.zNear       = rhs.zNear;
         ubo.zFar        = rhs.zFar;
         
-        // G-Buffer
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->writeToBuffer(&ubo);
-        passBuffers[static_cast<uint8_t>(PassName::GPass)][0]->unmap();
+        // G-Buffer and Deferred
+        auto& frameRing = *BufferManager::frameRing;
+        uboOffset = frameRing.push(ubo);
         
-        // SSAO
+        // SSAO and Composition
         compParams.projection    = rhs.projection;
         compParams.view          = rhs.view;
         compParams.inverseView   = rhs.inverseView;
@@ -1331,9 +1317,7 @@ namespace arx {
         compParams.ssaoBlur      = params.ssaoBlur;
         compParams.deferred      = params.deferred;
         
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->map();
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->writeToBuffer(&compParams);
-        passBuffers[static_cast<uint8_t>(PassName::SSAO)][1]->unmap();
+        compParamsOffset = frameRing.push(compParams);
         
         // Deferred
         ClusteredShading::Frustum frustumParams;
@@ -1342,25 +1326,8 @@ namespace arx {
         frustumParams.zFar = rhs.zFar;
         frustumParams.zNear = rhs.zNear;
         
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][4]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->writeToBuffer(&ubo);
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][4]->writeToBuffer(&frustumParams);
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][0]->unmap();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][4]->unmap();
-
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->map();
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->writeToBuffer(&Editor::data);
-        passBuffers[static_cast<uint8_t>(PassName::DEFERRED)][5]->unmap();
-        
-        // COMPOSITION
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->map();
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->writeToBuffer(&compParams);
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][0]->unmap();
-
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][1]->map();
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][1]->writeToBuffer(&Editor::data);
-        passBuffers[static_cast<uint8_t>(PassName::COMPOSITION)][1]->unmap();
+        frustumOffset = frameRing.push(frustumParams);
+        editorOffset = frameRing.push(Editor::data);
     }
 
     void ArxRenderer::init_Passes() {
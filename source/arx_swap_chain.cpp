@@ -1,6 +1,7 @@
 #include "../source/engine_pch.hpp"
 
 #include "../source/arx_swap_chain.h"
+#include "../source/arx_uploader.h"
 
 #define ARRAYSIZE(a) (sizeof(a) / sizeof(*(a)))
 
@@ -17,10 +18,7 @@ namespace arx {
         
         // Need to manually copy occlusion culling buffers
         if (previous) {
-            cull->cameraBuffer = previous->cull->cameraBuffer;
             cull->objectsDataBuffer = previous->cull->objectsDataBuffer;
-            cull->globalDataBuffer = previous->cull->globalDataBuffer;
-            cull->miscBuffer = previous->cull->miscBuffer;
         }
 
         // clean up old swap chain since it's no longer needed
@@ -111,7 +109,7 @@ namespace arx {
       return result;
     }
 
-    VkResult ArxSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+    VkResult ArxSwapChain::submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex, uint64_t uploadValue) {
       if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
         vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
       }
@@ -120,12 +118,19 @@ namespace arx {
       VkSubmitInfo submitInfo = {};
       submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-      VkSemaphore waitSemaphores[]      = {imageAvailableSemaphores[currentFrame]};
-      VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-      submitInfo.waitSemaphoreCount     = 1;
+      VkSemaphore waitSemaphores[]      = {imageAvailableSemaphores[currentFrame], device.uploader().timeline()};
+      VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+      uint64_t waitValues[]             = {0, uploadValue}; // Binary semaphores ignore theirs
+      submitInfo.waitSemaphoreCount     = uploadValue > 0 ? 2 : 1;
       submitInfo.pWaitSemaphores        = waitSemaphores;
       submitInfo.pWaitDstStageMask      = waitStages;
 
+      VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+      timelineInfo.sType                    = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+      timelineInfo.waitSemaphoreValueCount  = submitInfo.waitSemaphoreCount;
+      timelineInfo.pWaitSemaphoreValues     = waitValues;
+      submitInfo.pNext                      = &timelineInfo;
+
       submitInfo.commandBufferCount     = 1;
       submitInfo.pCommandBuffers        = buffers;
 
@@ -542,7 +547,12 @@ namespace arx {
         cull->depthPyramidWidth = cull->previousPow2(swapChainExtent.width);
         cull->depthPyramidHeight = cull->previousPow2(swapChainExtent.height);
         
-        uint32_t depthPyramidLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(swapChainExtent.width, swapChainExtent.height)))) + 1;
+        // Both sides are powers of two, the levels go down to 1x1
+        uint32_t depthPyramidLevels = static_cast<uint32_t>(std::log2(std::max(cull->depthPyramidWidth, cull->depthPyramidHeight))) + 1;
+        if (depthPyramidLevels > OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS) {
+            ARX_LOG_WARNING("Depth pyramid needs {} levels, building the first {}", depthPyramidLevels, OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS);
+            depthPyramidLevels = OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS;
+        }
         cull->depthPyramidLevels = depthPyramidLevels;
         
         createImage(cull->depthPyramidWidth, cull->depthPyramidHeight, depthPyramidLevels,
@@ -555,8 +565,17 @@ namespace arx {
                     cull->depthPyramidMemory);
         
         cull->depthPyramidImageView = createImageView(cull->depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, cull->depthPyramidLevels);
+        
+        cull->depthPyramidCounterBuffer = std::make_shared<ArxBuffer>(device,
+                                                                      sizeof(uint32_t),
+                                                                      1,
+                                                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         VkCommandBuffer cmd = device.beginSingleTimeCommands();
+        // The shader resets the counter itself once it's done with it
+        vkCmdFillBuffer(cmd, cull->depthPyramidCounterBuffer->getBuffer(), 0, sizeof(uint32_t), 0);
+        
         VkImageMemoryBarrier depthPyramidLayoutBarrier = createImageBarrier(VK_IMAGE_LAYOUT_UNDEFINED,
                                                                            VK_IMAGE_LAYOUT_GENERAL,
                                                                            cull->depthPyramidImage,
@@ -585,11 +604,14 @@ namespace arx {
         samplerCreateInfo.minLod = 0;
         samplerCreateInfo.maxLod = 16.f;
         
-//        VkSamplerReductionModeCreateInfo reductionCreateInfo = {};
-//        reductionCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
-//        reductionCreateInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
-//        samplerCreateInfo.pNext = &reductionCreateInfo;
-//        
+        // A max filter returns the furthest of the texels a bilinear lookup touches, which keeps the
+        // single lookup the culling does conservative. Plain bilinear averages them otherwise
+        VkSamplerReductionModeCreateInfo reductionCreateInfo = {};
+        reductionCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+        reductionCreateInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
+        if (device.supportsSamplerFilterMinmax())
+            samplerCreateInfo.pNext = &reductionCreateInfo;
+        
         if (vkCreateSampler(device.device(), &samplerCreateInfo, 0, &depthSampler) != VK_SUCCESS)
             ARX_LOG_ERROR("Couldn't create depth sampler!");
     }
@@ -615,17 +637,16 @@ namespace arx {
     }
 
     void ArxSwapChain::createCullingDescriptors() {
+        constexpr uint32_t frames = BufferManager::MAX_FRAMES_IN_FLIGHT;
+        
         cull->cullingDescriptorPool = ArxDescriptorPool::Builder(device)
-            .setMaxSets(1)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3.f)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5.f)
+            .setMaxSets(frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3 * frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 14 * frames)
             .build();
     
-        VkDescriptorBufferInfo cameraBufferInfo{};
-        cameraBufferInfo.buffer = cull->cameraBuffer->getBuffer();
-        cameraBufferInfo.offset = 0;
-        cameraBufferInfo.range = VK_WHOLE_SIZE;
+        auto cameraBufferInfo = BufferManager::frameRing->descriptorInfo(sizeof(OcclusionSystem::GPUCameraData));
         
         VkDescriptorBufferInfo objectsDataBufferInfo{};
         objectsDataBufferInfo.buffer = cull->objectsDataBuffer->getBuffer();
@@ -642,124 +663,120 @@ namespace arx {
         visibilityInfo.offset = 0;
         visibilityInfo.range = VK_WHOLE_SIZE;
         
-        VkDescriptorBufferInfo globalDataBufferInfo{};
-        globalDataBufferInfo.buffer = cull->globalDataBuffer->getBuffer();
-        globalDataBufferInfo.offset = 0;
-        globalDataBufferInfo.range = VK_WHOLE_SIZE;
+        auto globalDataBufferInfo = BufferManager::frameRing->descriptorInfo(sizeof(OcclusionSystem::GPUCullingGlobalData));
         
-        VkDescriptorBufferInfo miscBufferInfo{};
-        miscBufferInfo.buffer = cull->miscBuffer->getBuffer();
-        miscBufferInfo.offset = 0;
-        miscBufferInfo.range = VK_WHOLE_SIZE;
-        
-        VkDescriptorBufferInfo indirectBufferInfo{};
-        indirectBufferInfo.buffer = BufferManager::drawIndirectBuffer->getBuffer();
-        indirectBufferInfo.offset = 0;
-        indirectBufferInfo.range = VK_WHOLE_SIZE;
+        auto miscBufferInfo = BufferManager::frameRing->descriptorInfo(sizeof(OcclusionSystem::GPUMiscData));
         
         VkDescriptorBufferInfo instanceOffsetsInfo{};
         instanceOffsetsInfo.buffer = BufferManager::instanceOffsetBuffer->getBuffer();
         instanceOffsetsInfo.offset = 0;
         instanceOffsetsInfo.range = VK_WHOLE_SIZE;
         
-        VkDescriptorBufferInfo drawCommandCountBufferInfo{};
-        drawCommandCountBufferInfo.buffer = BufferManager::drawCommandCountBuffer->getBuffer();
-        drawCommandCountBufferInfo.offset = 0;
-        drawCommandCountBufferInfo.range = VK_WHOLE_SIZE;
-        
-        
-        ArxDescriptorWriter(*cull->cullingDescriptorLayout, *cull->cullingDescriptorPool)
-                            .writeBuffer(0, &cameraBufferInfo)
-                            .writeBuffer(1, &objectsDataBufferInfo)
-                            .writeImage(2, &depthPyramidInfo)
-                            .writeBuffer(3, &visibilityInfo)
-                            .writeBuffer(4, &globalDataBufferInfo)
-                            .writeBuffer(5, &miscBufferInfo)
-                            .writeBuffer(6, &indirectBufferInfo)
-                            .writeBuffer(7, &instanceOffsetsInfo)
-                            .writeBuffer(8, &drawCommandCountBufferInfo)
-                            .build(cull->cullingDescriptorSet);
+        auto cullNodesInfo = BufferManager::cullNodeBuffer->descriptorInfo();
+        auto nodeChunksInfo = BufferManager::nodeChunkBuffer->descriptorInfo();
+        auto nodeVisibilityInfo = BufferManager::nodeVisibilityBuffer->descriptorInfo();
+        auto bricksInfo = BufferManager::brickBuffer->descriptorInfo();
+        auto brickVisibilityInfo = BufferManager::brickVisibilityBuffer->descriptorInfo();
+        
+        for (uint32_t i = 0; i < frames; i++) {
+            VkDescriptorBufferInfo indirectBufferInfo{};
+            indirectBufferInfo.buffer = BufferManager::drawIndirectBuffers[i]->getBuffer();
+            indirectBufferInfo.offset = 0;
+            indirectBufferInfo.range = VK_WHOLE_SIZE;
+            
+            VkDescriptorBufferInfo drawCommandCountBufferInfo{};
+            drawCommandCountBufferInfo.buffer = BufferManager::drawCommandCountBuffers[i]->getBuffer();
+            drawCommandCountBufferInfo.offset = 0;
+            drawCommandCountBufferInfo.range = VK_WHOLE_SIZE;
+            
+            auto visibleNodesInfo = BufferManager::visibleNodeBuffers[i]->descriptorInfo();
+            auto nodeDispatchInfo = BufferManager::nodeDispatchBuffers[i]->descriptorInfo();
+            auto brickChunksInfo = BufferManager::brickChunkBuffers[i]->descriptorInfo();
+            auto brickDispatchInfo = BufferManager::brickDispatchBuffers[i]->descriptorInfo();
+            
+            ArxDescriptorWriter(*cull->cullingDescriptorLayout, *cull->cullingDescriptorPool)
+                                .writeBuffer(0, &cameraBufferInfo)
+                                .writeBuffer(1, &objectsDataBufferInfo)
+                                .writeImage(2, &depthPyramidInfo)
+                                .writeBuffer(3, &visibilityInfo)
+                                .writeBuffer(4, &globalDataBufferInfo)
+                                .writeBuffer(5, &miscBufferInfo)
+                                .writeBuffer(6, &indirectBufferInfo)
+                                .writeBuffer(7, &instanceOffsetsInfo)
+                                .writeBuffer(8, &drawCommandCountBufferInfo)
+                                .writeBuffer(9, &cullNodesInfo)
+                                .writeBuffer(10, &nodeChunksInfo)
+                                .writeBuffer(11, &visibleNodesInfo)
+                                .writeBuffer(12, &nodeVisibilityInfo)
+                                .writeBuffer(13, &nodeDispatchInfo)
+                                .writeBuffer(14, &bricksInfo)
+                                .writeBuffer(15, &brickVisibilityInfo)
+                                .writeBuffer(16, &brickChunksInfo)
+                                .writeBuffer(17, &brickDispatchInfo)
+                                .build(cull->cullingDescriptorSets[i]);
+        }
     }
 
     void ArxSwapChain::createDepthPyramidDescriptors() {
-        cull->depthDescriptorSets.resize(cull->depthPyramidLevels, VK_NULL_HANDLE);
-        
         cull->depthDescriptorPool = ArxDescriptorPool::Builder(device)
-                            .setMaxSets(cull->depthPyramidLevels)
-                            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, cull->depthPyramidLevels)
-                            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, cull->depthPyramidLevels)
+                            .setMaxSets(1)
+                            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
+                            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS)
+                            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
                             .build();
 
-        
-        for (uint32_t i = 0; i < cull->depthPyramidLevels; i++) {
-            VkDescriptorImageInfo srcInfo = {};
-            if (i == 0) {
-                srcInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                srcInfo.imageView = textureManager.getAttachment("gDepth")->view;
-            }
-            else {
-                srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-                srcInfo.imageView = cull->depthPyramidMips[i-1];
-            }
-            srcInfo.sampler = depthSampler;
-
-            VkDescriptorImageInfo dstInfo;
-            dstInfo.sampler = depthSampler;
-            dstInfo.imageView = cull->depthPyramidMips[i];
-            dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-            
-            ArxDescriptorWriter(*cull->depthDescriptorLayout, *cull->depthDescriptorPool)
-                .writeImage(0, &dstInfo)
-                .writeImage(1, &srcInfo)
-                .build(cull->depthDescriptorSets[i]);
+        // Every slot needs a valid view, the ones past the last level repeat it and are never written
+        std::array<VkDescriptorImageInfo, OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS> dstInfos;
+        for (uint32_t i = 0; i < OcclusionSystem::MAX_DEPTH_PYRAMID_LEVELS; i++) {
+            dstInfos[i].sampler = depthSampler;
+            dstInfos[i].imageView = cull->depthPyramidMips[std::min(i, cull->depthPyramidLevels - 1)];
+            dstInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
         }
+        
+        VkDescriptorImageInfo srcInfo = {};
+        srcInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        srcInfo.imageView = textureManager.getAttachment("gDepth")->view;
+        srcInfo.sampler = depthSampler;
+        
+        auto counterInfo = cull->depthPyramidCounterBuffer->descriptorInfo();
+        
+        ArxDescriptorWriter(*cull->depthDescriptorLayout, *cull->depthDescriptorPool)
+            .writeImages(0, dstInfos.data(), static_cast<uint32_t>(dstInfos.size()))
+            .writeImage(1, &srcInfo)
+            .writeBuffer(2, &counterInfo)
+            .build(cull->depthDescriptorSet);
     }
 
     void ArxSwapChain::computeDepthPyramid(VkCommandBuffer commandBuffer) {
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &cull->framebufferDepthWriteBarrier);
+        // Compute in the source scope too, the previous frame's late cull may still sample the pyramid about to be rewritten
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &cull->framebufferDepthWriteBarrier);
         
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->depthPyramidPipeline->computePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->depthPyramidPipelineLayout, 0, 1, &cull->depthDescriptorSet, 0, nullptr);
         
-        for (uint32_t i = 0; i < cull->depthPyramidLevels; ++i)
-        {
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->depthPyramidPipelineLayout, 0, 1, &cull->depthDescriptorSets[i], 0, nullptr);
-
-            uint32_t levelWidth = glm::max(1u, cull->depthPyramidWidth >> i);
-            uint32_t levelHeight = glm::max(1u, cull->depthPyramidHeight >> i);
-
-            glm::vec2 levelSize(levelWidth, levelHeight);
-
-            uint32_t groupCountX = (levelWidth + 32 - 1) / 32;
-            uint32_t groupCountY = (levelHeight + 32 - 1) / 32;
-            vkCmdPushConstants(commandBuffer, cull->depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::vec2), &levelSize);
-            vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
-
-            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &cull->depthPyramidMipLevelBarriers[i]);
-        }
+        // One workgroup per 64x64 tile of mip 0, the last one to finish builds the levels under 64x64
+        uint32_t groupCountX = (cull->depthPyramidWidth + 64 - 1) / 64;
+        uint32_t groupCountY = (cull->depthPyramidHeight + 64 - 1) / 64;
+        
+        OcclusionSystem::DepthReduceData reduceData{};
+        reduceData.pyramidSize = glm::uvec2(cull->depthPyramidWidth, cull->depthPyramidHeight);
+        reduceData.levelCount = cull->depthPyramidLevels;
+        reduceData.groupCount = groupCountX * groupCountY;
+        
+        vkCmdPushConstants(commandBuffer, cull->depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionSystem::DepthReduceData), &reduceData);
+        vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+        
+        // The whole pyramid and the counter reset, for the late cull and the next frame's dispatch
+        VkMemoryBarrier pyramidBarrier = {};
+        pyramidBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        pyramidBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &pyramidBarrier, 0, 0, 0, 0);
 
         vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &cull->framebufferDepthReadBarrier);
     }
 
     void ArxSwapChain::createBarriers() {
-        // Barriers for layout transition between read and write access of the depth pyramid's levels
-        cull->depthPyramidMipLevelBarriers.resize(cull->depthPyramidLevels, {});
-        for (uint32_t i = 0; i < cull->depthPyramidLevels; ++i) {
-            VkImageMemoryBarrier& barrier = cull->depthPyramidMipLevelBarriers[i];
-            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrier.image = cull->depthPyramidImage;
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            barrier.subresourceRange.baseMipLevel = i;
-            barrier.subresourceRange.levelCount = 1;
-            barrier.subresourceRange.baseArrayLayer = 0;
-            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-        }
-
         // Barriers for read/write access of the single sampled depth image attached to the framebuffers
         cull->framebufferDepthWriteBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         cull->framebufferDepthWriteBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
@@ -786,17 +803,55 @@ namespace arx {
         cull->framebufferDepthReadBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
     }
 
-    void ArxSwapChain::computeCulling(VkCommandBuffer commandBuffer, const uint32_t chunkCount, bool early) {
+    void ArxSwapChain::computeCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool early) {
+        if (early) {
+            // The visibility of the previous frame's late cull is shared by every frame in flight
+            VkBufferMemoryBarrier visibilityBarriers[] = {
+                BufferManager::bufferBarrier(BufferManager::visibilityBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+                BufferManager::bufferBarrier(BufferManager::nodeVisibilityBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+                BufferManager::bufferBarrier(BufferManager::brickVisibilityBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, ARRAYSIZE(visibilityBarriers), visibilityBarriers, 0, 0);
+        }
+        
+        // Hierarchy nodes first, survivors are appended with the group count of the chunk pass
+        BufferManager::resetCullDispatchBuffers(commandBuffer, frameIndex);
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->nodeCullingPipeline->computePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->nodeCullingPipelineLayout, 0, 1, &cull->cullingDescriptorSets[frameIndex],
+                                static_cast<uint32_t>(cull->dynamicOffsets.size()), cull->dynamicOffsets.data());
+        
+        OcclusionSystem::NodeCullingData nodeCullingData{early ? 1u : 0u};
+        vkCmdPushConstants(commandBuffer, cull->nodeCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionSystem::NodeCullingData), &nodeCullingData);
+        vkCmdDispatch(commandBuffer, (cull->cullingData.nodesCount + 63) / 64, 1, 1);
+        
+        // Each pass' lists and group counts, for the pass after it
+        VkMemoryBarrier passBarrier = {};
+        passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, 0, 0, 0);
+        
+        // One workgroup per surviving node, a thread per chunk. Full resolution instanced chunks are handed on to the bricks
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, early ? cull->earlyCullingPipeline->computePipeline : cull->cullingPipeline->computePipeline);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, early ? cull->earlyCullingPipelineLayout : cull->cullingPipelineLayout, 0, 1, &cull->cullingDescriptorSet, 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, early ? cull->earlyCullingPipelineLayout : cull->cullingPipelineLayout, 0, 1, &cull->cullingDescriptorSets[frameIndex],
+                                static_cast<uint32_t>(cull->dynamicOffsets.size()), cull->dynamicOffsets.data());
         
-        uint32_t groupCountX = static_cast<uint32_t>((chunkCount / 256) + 1);
-        vkCmdDispatch(commandBuffer, groupCountX, 1, 1);
+        vkCmdDispatchIndirect(commandBuffer, BufferManager::nodeDispatchBuffers[frameIndex]->getBuffer(), 0);
+        
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, 0, 0, 0);
+        
+        // One workgroup per chunk, a thread per brick
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->brickCullingPipeline->computePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull->nodeCullingPipelineLayout, 0, 1, &cull->cullingDescriptorSets[frameIndex],
+                                static_cast<uint32_t>(cull->dynamicOffsets.size()), cull->dynamicOffsets.data());
+        vkCmdPushConstants(commandBuffer, cull->nodeCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionSystem::NodeCullingData), &nodeCullingData);
+        vkCmdDispatchIndirect(commandBuffer, BufferManager::brickDispatchBuffers[frameIndex]->getBuffer(), 0);
         
         VkBufferMemoryBarrier cullBarriers[] = {
-            BufferManager::bufferBarrier(BufferManager::drawIndirectBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
-            BufferManager::bufferBarrier(BufferManager::drawCommandCountBuffer->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
+            BufferManager::bufferBarrier(BufferManager::drawIndirectBuffers[frameIndex]->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+            BufferManager::bufferBarrier(BufferManager::drawCommandCountBuffers[frameIndex]->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)
         };
         
         vkCmdPipelineBarrier(commandBuffer,
@@ -805,6 +860,9 @@ namespace arx {
                              0, 0, 0,
                              ARRAYSIZE(cullBarriers),
                              cullBarriers, 0, 0);
+        
+        if (!early)
+            BufferManager::copyDrawCommandCount(commandBuffer, frameIndex);
     }
 
     void ArxSwapChain::loadGeometryToDevice() {
@@ -828,47 +886,13 @@ namespace arx {
         BufferManager::visibilityBuffer->map();
         BufferManager::visibilityBuffer->writeToBuffer(BufferManager::visibilityData.data());
         
-        // Global data
-        cull->globalDataBuffer = std::make_shared<ArxBuffer>(device,
-                                                            sizeof(OcclusionSystem::GPUCullingGlobalData),
-                                                            1,
-                                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        // Culling nodes, built with the object data
+        BufferManager::createCullNodeBuffers(device, cull->cullNodes, cull->nodeChunks);
+        BufferManager::createBrickBuffers(device, cull->brickData, static_cast<uint32_t>(cull->objectData.size()));
         
-        cull->globalDataBuffer->map();
-        cull->globalDataBuffer->writeToBuffer(&cull->cullingData);
-                
-        // GPUCameraData
-        cull->cameraBuffer = std::make_shared<ArxBuffer>(device,
-                                                        sizeof(OcclusionSystem::GPUCameraData),
-                                                        1,
-                                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        
-        cull->cameraBuffer->map();
-        cull->cameraBuffer->writeToBuffer(&cull->cameraData);
-        
-        // GPUMiscData
-        cull->miscBuffer = std::make_shared<ArxBuffer>(device,
-                                                      sizeof(OcclusionSystem::GPUMiscData),
-                                                      1,
-                                                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        
-        cull->miscBuffer->map();
-        cull->miscBuffer->writeToBuffer(&cull->miscData);
-        
-        // Draw Indirect Buffer
+        // Draw Indirect and Draw Command Count Buffers
         // indirectDrawData is initialized in the App.cpp
-        BufferManager::drawIndirectBuffer = std::make_shared<ArxBuffer>(device,
-                                                                        sizeof(GPUIndirectDrawCommand),
-                                                                        BufferManager::indirectDrawData.size(),
-                                                                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        
-        BufferManager::drawIndirectBuffer->map();
-        BufferManager::drawIndirectBuffer->writeToBuffer(BufferManager::indirectDrawData.data());
+        BufferManager::createDrawCommandBuffers(device);
         
         // Instance Offset Buffer
         BufferManager::instanceOffsetBuffer = std::make_shared<ArxBuffer>(device,
@@ -883,32 +907,13 @@ namespace arx {
         BufferManager::instanceOffsetBuffer->map();
         BufferManager::instanceOffsetBuffer->writeToBuffer(BufferManager::instanceOffsets.data());
         
-        // Draw Command Count Buffer
-        BufferManager::drawCommandCountBuffer = std::make_shared<ArxBuffer>(device,
-                                                                            sizeof(uint32_t),
-                                                                            1,
-                                                                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-                                                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
-                                                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        
-        uint32_t zero = 0;
-        BufferManager::drawCommandCountBuffer->map();
-        BufferManager::drawCommandCountBuffer->writeToBuffer(&zero, sizeof(uint32_t));
-        
         createCullingDescriptors();
     }
 
     void ArxSwapChain::updateDynamicData() {
-        // Culling Data
-        cull->globalDataBuffer->writeToBuffer(&cull->cullingData, static_cast<uint64_t>(sizeof(OcclusionSystem::GPUCullingGlobalData)));
-        
-        // Update camera
-        cull->cameraBuffer->writeToBuffer(&cull->cameraData, static_cast<uint64_t>(sizeof(OcclusionSystem::GPUCameraData)));
-        
-        // Update misc data
-        cull->miscBuffer->writeToBuffer(&cull->miscData, static_cast<uint64_t>(sizeof(OcclusionSystem::GPUMiscData)));
+        // Pushed into the frame ring, culling dispatches recorded after this read the new offsets
+        cull->dynamicOffsets[0] = BufferManager::frameRing->push(cull->cameraData);
+        cull->dynamicOffsets[1] = BufferManager::frameRing->push(cull->cullingData);
+        cull->dynamicOffsets[2] = BufferManager::frameRing->push(cull->miscData);
     }
 }
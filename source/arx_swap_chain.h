@@ -38,7 +38,8 @@ class ArxSwapChain {
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t *imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+        // uploadValue is the uploader timeline value the frame waits on, 0 when it acquired nothing
+        VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex, uint64_t uploadValue = 0);
     
         bool compareSwapFormats(const ArxSwapChain &swapChain) const {
             return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -117,6 +118,6 @@ class ArxSwapChain {
     
         void createCullingDescriptors();
         void updateDynamicData();
-        void computeCulling(VkCommandBuffer commandBuffer, const uint32_t chunkCount, bool early = false);
+        void computeCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool early = false);
     };
 }
@@ -0,0 +1,361 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/arx_uploader.h"
+
+namespace arx {
+
+    ArxUploader::ArxUploader(ArxDevice &device) : arxDevice{device} {
+        QueueFamilyIndices indices = arxDevice.findPhysicalQueueFamilies();
+        transferFamily      = indices.transferFamily;
+        graphicsFamily      = indices.graphicsFamily;
+        ownershipTransfer   = transferFamily != graphicsFamily;
+        if (ownershipTransfer)
+            ARX_LOG_INFO("Uploading on transfer queue family {}", transferFamily);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = transferFamily;
+        poolInfo.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if (vkCreateCommandPool(arxDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            ARX_LOG_ERROR("Failed to create upload command pool!");
+        }
+
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType  = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue   = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(arxDevice.device(), &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS) {
+            ARX_LOG_ERROR("Failed to create upload timeline semaphore!");
+        }
+
+        for (Batch& batch : batches) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool        = commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(arxDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+                ARX_LOG_ERROR("Failed to allocate upload command buffer!");
+            }
+
+            batch.staging = std::make_unique<ArxBuffer>(
+                arxDevice,
+                1,
+                static_cast<uint32_t>(STAGING_SIZE),
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            batch.staging->map();
+        }
+    }
+
+    ArxUploader::~ArxUploader() {
+        commit();
+
+        for (Batch& batch : batches)
+            vkFreeCommandBuffers(arxDevice.device(), commandPool, 1, &batch.commandBuffer);
+        vkDestroyCommandPool(arxDevice.device(), commandPool, nullptr);
+        vkDestroySemaphore(arxDevice.device(), timelineSemaphore, nullptr);
+    }
+
+    ArxUploader::Batch& ArxUploader::current() {
+        Batch& batch = batches[currentBatch];
+        if (!batch.recording) {
+            wait(batch);
+
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+            batch.recording = true;
+        }
+        return batch;
+    }
+
+    void ArxUploader::wait(Batch& batch) {
+        if (!batch.inFlight) return;
+
+        waitValue(batch.value);
+        batch.oversized.clear();
+        batch.used = 0;
+        batch.inFlight = false;
+    }
+
+    void ArxUploader::waitValue(uint64_t value) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores    = &timelineSemaphore;
+        waitInfo.pValues        = &value;
+        vkWaitSemaphores(arxDevice.device(), &waitInfo, UINT64_MAX);
+    }
+
+    uint64_t ArxUploader::completedValue() const {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(arxDevice.device(), timelineSemaphore, &value);
+        return value;
+    }
+
+    std::pair<VkBuffer, VkDeviceSize> ArxUploader::stage(const void* data, VkDeviceSize size) {
+        if (size > STAGING_SIZE) {
+            auto staging = std::make_unique<ArxBuffer>(
+                arxDevice,
+                size,
+                1,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+            staging->map();
+            staging->writeToBuffer(const_cast<void*>(data), size);
+
+            Batch& batch = current();
+            VkBuffer buffer = staging->getBuffer();
+            batch.oversized.push_back(std::move(staging));
+            return {buffer, 0};
+        }
+
+        // Keep copy sources 16 byte aligned, start the next batch once this one is full
+        Batch* batch = &current();
+        VkDeviceSize offset = (batch->used + 15) & ~VkDeviceSize(15);
+        if (offset + size > STAGING_SIZE) {
+            flush();
+            batch = &current();
+            offset = 0;
+        }
+
+        batch->staging->writeToBuffer(const_cast<void*>(data), size, offset);
+        batch->used = offset + size;
+        return {batch->staging->getBuffer(), offset};
+    }
+
+    void ArxUploader::uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+        if (size == 0) return;
+
+        auto [srcBuffer, srcOffset] = stage(data, size);
+        copyBuffer(srcBuffer, dstBuffer, size, srcOffset, dstOffset);
+    }
+
+    void ArxUploader::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
+        Batch& batch = current();
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = size;
+        vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+        if (!ownershipTransfer) return;
+
+        // Back to back copies into one buffer share a release, createLargeInstanceBuffer issues one per chunk
+        if (!batch.releases.empty()) {
+            VkBufferMemoryBarrier& last = batch.releases.back();
+            if (last.buffer == dstBuffer && last.offset + last.size == dstOffset) {
+                last.size += size;
+                return;
+            }
+        }
+
+        VkBufferMemoryBarrier release{};
+        release.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask       = 0;
+        release.srcQueueFamilyIndex = transferFamily;
+        release.dstQueueFamilyIndex = graphicsFamily;
+        release.buffer              = dstBuffer;
+        release.offset              = dstOffset;
+        release.size                = size;
+        batch.releases.push_back(release);
+    }
+
+    void ArxUploader::uploadImage(VkImage dstImage, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, VkImageLayout finalLayout) {
+        auto [srcBuffer, srcOffset] = stage(data, size);
+        Batch& batch = current();
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask                   = 0;
+        barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = dstImage;
+        barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset                    = srcOffset;
+        region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel       = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount     = 1;
+        region.imageOffset                     = {0, 0, 0};
+        region.imageExtent                     = {width, height, 1};
+        vkCmdCopyBufferToImage(batch.commandBuffer, srcBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout     = finalLayout;
+
+        // The release carries the layout change, the graphics queue repeats it when acquiring
+        if (ownershipTransfer) {
+            barrier.dstAccessMask       = 0;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            batch.imageReleases.push_back(barrier);
+            return;
+        }
+
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    uint64_t ArxUploader::flush() {
+        Batch& batch = batches[currentBatch];
+        if (!batch.recording) return submittedValue;
+
+        if (ownershipTransfer) {
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0, 0, nullptr, static_cast<uint32_t>(batch.releases.size()), batch.releases.data(),
+                                 static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data());
+        }
+        else {
+            // Same queue as the frames, later submissions see the copies through submission order
+            VkMemoryBarrier barrier{};
+            barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        batch.value = ++submittedValue;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues    = &batch.value;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext                = &timelineInfo;
+        submitInfo.commandBufferCount   = 1;
+        submitInfo.pCommandBuffers      = &batch.commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &timelineSemaphore;
+
+        if (vkQueueSubmit(arxDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            ARX_LOG_ERROR("Failed to submit upload batch!");
+        }
+
+        if (ownershipTransfer)
+            pendingAcquires.push_back({batch.value, std::move(batch.releases), std::move(batch.imageReleases)});
+        else
+            acquiredValue = batch.value;
+        batch.releases.clear();
+        batch.imageReleases.clear();
+
+        batch.recording = false;
+        batch.inFlight = true;
+        currentBatch = (currentBatch + 1) % batches.size();
+        return batch.value;
+    }
+
+    void ArxUploader::recordAcquires(VkCommandBuffer commandBuffer, size_t count) {
+        std::vector<VkBufferMemoryBarrier> acquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+        for (size_t i = 0; i < count; ++i) {
+            for (VkBufferMemoryBarrier barrier : pendingAcquires[i].barriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                acquires.push_back(barrier);
+            }
+            for (VkImageMemoryBarrier barrier : pendingAcquires[i].imageBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                imageAcquires.push_back(barrier);
+            }
+        }
+
+        // Chains with the timeline wait, which the submit places at all commands
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0, 0, nullptr, static_cast<uint32_t>(acquires.size()), acquires.data(),
+                             static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+
+        acquiredValue = pendingAcquires[count - 1].value;
+        pendingAcquires.erase(pendingAcquires.begin(), pendingAcquires.begin() + count);
+    }
+
+    uint64_t ArxUploader::acquire(VkCommandBuffer commandBuffer) {
+        if (pendingAcquires.empty()) return 0;
+
+        const uint64_t completed = completedValue();
+        size_t count = 0;
+        while (count < pendingAcquires.size() && pendingAcquires[count].value <= completed)
+            ++count;
+        if (count == 0) return 0;
+
+        recordAcquires(commandBuffer, count);
+        return acquiredValue;
+    }
+
+    void ArxUploader::commit() {
+        flush();
+        for (Batch& batch : batches)
+            wait(batch);
+
+        if (pendingAcquires.empty()) return;
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool        = arxDevice.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(arxDevice.device(), &allocInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        recordAcquires(commandBuffer, pendingAcquires.size());
+        vkEndCommandBuffer(commandBuffer);
+
+        const uint64_t waitValue = acquiredValue;
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType                   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues    = &waitValue;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext              = &timelineInfo;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores    = &timelineSemaphore;
+        submitInfo.pWaitDstStageMask  = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &commandBuffer;
+
+        vkQueueSubmit(arxDevice.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(arxDevice.graphicsQueue());
+
+        vkFreeCommandBuffers(arxDevice.device(), arxDevice.getCommandPool(), 1, &commandBuffer);
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../source/arx_buffer.h"
+
+namespace arx {
+
+    // Records staging copies into one command buffer per batch instead of a blocking submit per copy.
+    // Batches run on the transfer queue, a dedicated copy family when the device has one and the graphics
+    // queue otherwise. Every submit signals the next value of a timeline semaphore, two batches alternate
+    // so the next one records while the previous is in flight. Not thread safe
+    //
+    // With a separate family the copied ranges are released to the graphics family, a graphics command
+    // buffer has to acquire them (see acquire) before reading them
+    class ArxUploader {
+    public:
+        static constexpr VkDeviceSize STAGING_SIZE = 32 * 1024 * 1024; // Per batch, larger uploads get their own staging buffer
+
+        explicit ArxUploader(ArxDevice &device);
+        ~ArxUploader();
+
+        ArxUploader(const ArxUploader&) = delete;
+        ArxUploader& operator=(const ArxUploader&) = delete;
+
+        // data is copied into staging memory right away and can go as soon as this returns
+        void uploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+        // srcBuffer has to stay alive until the batch completes, see commit
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+        // Fills mip 0 of a single layer color image and leaves it in finalLayout, the previous contents are discarded
+        void uploadImage(VkImage dstImage, const void* data, VkDeviceSize size, uint32_t width, uint32_t height,
+                         VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        // Submits the recorded copies without waiting, returns the timeline value they signal
+        uint64_t flush();
+        // Flushes, waits for every batch and hands the copies to the graphics queue, staging memory is free again afterwards
+        void commit();
+
+        // Records the ownership acquires of every batch that has finished into a graphics command buffer.
+        // The submit of commandBuffer waits on timeline() at the returned value, 0 means nothing to wait on.
+        // Never stalls, uploads still in flight get picked up by a later frame
+        uint64_t acquire(VkCommandBuffer commandBuffer);
+
+        VkSemaphore timeline() const { return timelineSemaphore; }
+        // Copies up to this value are done on the transfer queue
+        uint64_t completedValue() const;
+        // Copies up to this value can be read by graphics commands recorded from now on
+        uint64_t readyValue() const { return acquiredValue; }
+        bool isReady(uint64_t value) const { return value <= acquiredValue; }
+
+    private:
+        struct Batch {
+            VkCommandBuffer                             commandBuffer = VK_NULL_HANDLE;
+            std::unique_ptr<ArxBuffer>                  staging;
+            std::vector<std::unique_ptr<ArxBuffer>>     oversized; // Uploads larger than STAGING_SIZE
+            std::vector<VkBufferMemoryBarrier>          releases;  // Copied ranges, only with a separate transfer family
+            std::vector<VkImageMemoryBarrier>           imageReleases;
+            VkDeviceSize                                used = 0;
+            uint64_t                                    value = 0; // Timeline value of the last submit
+            bool                                        recording = false;
+            bool                                        inFlight = false;
+        };
+
+        struct PendingAcquire {
+            uint64_t                                    value;
+            std::vector<VkBufferMemoryBarrier>          barriers;
+            std::vector<VkImageMemoryBarrier>           imageBarriers;
+        };
+
+        // The batch being recorded, begins one when needed
+        Batch& current();
+        // Copies data into staging memory of the current batch, returns the buffer and offset to copy from
+        std::pair<VkBuffer, VkDeviceSize> stage(const void* data, VkDeviceSize size);
+        void wait(Batch& batch);
+        void waitValue(uint64_t value);
+        void recordAcquires(VkCommandBuffer commandBuffer, size_t count);
+
+        ArxDevice                   &arxDevice;
+        VkCommandPool               commandPool = VK_NULL_HANDLE;
+        VkSemaphore                 timelineSemaphore = VK_NULL_HANDLE;
+        uint32_t                    transferFamily;
+        uint32_t                    graphicsFamily;
+        bool                        ownershipTransfer; // Transfer and graphics families differ
+
+        std::array<Batch, 2>        batches;
+        uint32_t                    currentBatch = 0;
+        uint64_t                    submittedValue = 0;
+        uint64_t                    acquiredValue = 0;
+        std::vector<PendingAcquire> pendingAcquires; // In submit order
+    };
+}
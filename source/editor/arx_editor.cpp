@@ -2,26 +2,19 @@
 
 #include "../source/editor/arx_editor.hpp"
 #include "../source/managers/arx_buffer_manager.hpp"
+#include "../source/editor/profiling/arx_profiler.hpp"
 
 namespace arx {
-    std::shared_ptr<ArxBuffer>  Editor::editorDataBuffer;
     Editor::EditorImGuiData     Editor::data;
 
     Editor::Editor(ArxDevice& device, GLFWwindow* window, TextureManager& textureManager)
     : arxDevice(device), window(window), textureManager(textureManager) {
         std::filesystem::path path = std::filesystem::current_path() / ".." / ".." / "imgui.ini";
         iniPath = path.string();
-
-        editorDataBuffer = std::make_shared<ArxBuffer>(arxDevice,
-                                                       sizeof(EditorImGuiData),
-                                                       1,
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
     }
 
     Editor::~Editor() {
         cleanup();
-        editorDataBuffer.reset();
     }
 
     void Editor::init() {
@@ -221,7 +214,7 @@ namespace arx {
         ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Information");
         ImGui::Separator();
         ImGui::Text("Press I for ImGui, O for game");
-        ImGui::Text("Chunks: %d", static_cast<uint32_t>(BufferManager::readDrawCommandCount()));
+        ImGui::Text("Draws: %u", BufferManager::lastDrawCommandCount);
         ImGui::Spacing();
 
         float labelWidth = ImGui::GetFontSize() * 1.2f;
@@ -234,6 +227,8 @@ namespace arx {
             ImGui::Checkbox("Frustum Culling", reinterpret_cast<bool*>(&data.camera.frustumCulling));
             ImGui::Checkbox("Occlusion Culling", reinterpret_cast<bool*>(&data.camera.occlusionCulling));
             ImGui::Checkbox("Freeze Culling", reinterpret_cast<bool*>(&data.camera.disableCulling));
+            ImGui::Checkbox("Greedy Meshing", reinterpret_cast<bool*>(&data.camera.greedyMeshing));
+            ImGui::Checkbox("Chunk LOD", reinterpret_cast<bool*>(&data.camera.chunkLod));
 
             ImGui::Text("zNear");
             ImGui::PushItemWidth(inputWidth);
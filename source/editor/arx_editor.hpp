@@ -17,11 +17,11 @@ namespace arx {
                 uint32_t frustumCulling = true;
                 uint32_t occlusionCulling = true;
                 uint32_t disableCulling = false;
-                uint32_t padding0;
+                uint32_t greedyMeshing = false;
                 float zNear = .1f;
                 float zFar = 1024.f;
                 float speed = 40.f;
-                float padding1;
+                uint32_t chunkLod = true;
                 glm::vec3 position = glm::vec3(0.0, -20.0, -10.0f);
                 float padding2;
             } camera;
@@ -56,7 +56,6 @@ namespace arx {
         void addLogMessage(const std::string& message);
         EditorImGuiData& getImGuiData() { return imguiData; }
 
-        static std::shared_ptr<ArxBuffer>   editorDataBuffer;
         static EditorImGuiData              data;
 
     private:
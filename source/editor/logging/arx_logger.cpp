@@ -1,10 +1,8 @@
 #include "../source/editor/logging/arx_logger.hpp"
 
-#include "../source/editor/arx_editor.hpp"
-
 namespace arx {
     std::vector<LogEntry> Logger::logEntries;
-    std::shared_ptr<Editor> Logger::editor = nullptr;
+    std::function<void(const std::string&)> Logger::sink;
 
     void Logger::log(LogType level, const std::string& message) {
         std::string timestamp = getCurrentTimestamp();
@@ -13,15 +11,15 @@ namespace arx {
         std::string fullMessage = "[" + timestamp + "] " + typeToString(level) + ": " + message;
         std::cout << fullMessage << std::endl;
 
-        if (editor) {
-            editor->addLogMessage(fullMessage);
+        if (sink) {
+            sink(fullMessage);
         }
     }
 
     void Logger::shutdown() {
         writeLogFile();
         logEntries.clear();
-        editor.reset();
+        sink = nullptr;
     }
 
     std::string Logger::typeToString(LogType level) {
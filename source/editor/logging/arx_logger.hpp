@@ -6,12 +6,11 @@
 #include <iostream>
 #include <ctime>
 #include <string>
+#include <functional>
 
 
 namespace arx {
 
-    class Editor;
-
     #define ARX_LOG_DEBUG(text, ...)    { arx::Logger::logf(arx::LogType::DEBUG,    std::string(__FUNCTION__) + ": " + std::string(text), ##__VA_ARGS__); }
     #define ARX_LOG_INFO(text, ...)     { arx::Logger::logf(arx::LogType::INFO,     std::string(__FUNCTION__) + ": " + std::string(text), ##__VA_ARGS__); }
     #define ARX_LOG_WARNING(text, ...)  { arx::Logger::logf(arx::LogType::WARNING,  std::string(__FUNCTION__) + ": " + std::string(text), ##__VA_ARGS__); }
@@ -44,7 +43,8 @@ namespace arx {
             log(level, oss.str());
         }
 
-        static void setEditor(std::shared_ptr<Editor> editor) { Logger::editor = editor; }
+        // Every formatted line is also handed to the sink, the editor console when there is one
+        static void setSink(std::function<void(const std::string&)> sink) { Logger::sink = std::move(sink); }
 
     private:
         Logger() = delete;
@@ -67,7 +67,7 @@ namespace arx {
             oss << format;
         }
 
-        static std::shared_ptr<Editor> editor;
+        static std::function<void(const std::string&)> sink;
         static std::vector<LogEntry> logEntries;
         static std::string typeToString(LogType level);
         static std::string getCurrentTimestamp();
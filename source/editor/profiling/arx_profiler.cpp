@@ -6,18 +6,6 @@
 
 namespace arx {
 
-    std::chrono::high_resolution_clock::time_point Timer::start_time;
-
-    void Timer::start() {
-        start_time = std::chrono::high_resolution_clock::now();
-    }
-
-    double Timer::stop() {
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end_time - start_time);
-        return duration.count();
-    }
-
     std::array<VkQueryPool, Profiler::BUFFER_COUNT> Profiler::queryPools = {VK_NULL_HANDLE, VK_NULL_HANDLE};
     std::array<std::vector<std::pair<std::string, uint32_t>>, Profiler::BUFFER_COUNT> Profiler::activeQueries;
     uint32_t Profiler::currentBufferIndex = 0;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../source/arx_device.h"
+#include "../source/editor/profiling/arx_timer.hpp"
 #include <chrono>
 #include <string>
 #include <vector>
@@ -9,14 +10,6 @@
 
 namespace arx {
 
-    class Timer {
-    public:
-        static void start();
-        static double stop();
-
-        static std::chrono::high_resolution_clock::time_point start_time;
-    };
-
     class Profiler {
     public:
         enum class Type {
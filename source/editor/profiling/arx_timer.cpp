@@ -0,0 +1,16 @@
+#include "../source/editor/profiling/arx_timer.hpp"
+
+namespace arx {
+
+    std::chrono::high_resolution_clock::time_point Timer::start_time;
+
+    void Timer::start() {
+        start_time = std::chrono::high_resolution_clock::now();
+    }
+
+    double Timer::stop() {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(end_time - start_time);
+        return duration.count();
+    }
+}
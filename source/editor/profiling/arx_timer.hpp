@@ -0,0 +1,15 @@
+#pragma once
+
+#include <chrono>
+
+namespace arx {
+
+    // CPU stopwatch in ms, free of the device so the offline tools can use it too
+    class Timer {
+    public:
+        static void start();
+        static double stop();
+
+        static std::chrono::high_resolution_clock::time_point start_time;
+    };
+}
@@ -33,4 +33,4 @@
 
 // Arx
 #include "../source/editor/logging/arx_logger.hpp"
-#include "../source/editor/profiling/arx_profiler.hpp"
+#include "../source/editor/profiling/arx_timer.hpp"
@@ -4,153 +4,220 @@
 
 namespace arx {
 
-    std::shared_ptr<ArxBuffer> Materials::pointLightBuffer;
+    std::array<std::shared_ptr<ArxBuffer>, Materials::FRAMES> Materials::pointLightBuffers;
     std::unordered_map<uint32_t, ChunkLightInfo> Materials::chunkLightInfos;
     std::vector<PointLight> Materials::pointLightsCPU;
     uint32_t Materials::maxPointLights = 0;
     uint32_t Materials::currentPointLightCount = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> Materials::freeSlabs;
+    std::array<std::vector<std::pair<uint32_t, uint32_t>>, Materials::FRAMES> Materials::dirtyRanges;
+    uint32_t Materials::liveLightCount = 0;
 
-    void Materials::initialize(ArxDevice& device, std::unordered_map<uint32_t, std::vector<PointLight>>& chunkLights) {
-        
-        maxPointLights = 0;
-        for (const auto& [chunkID, lights] : chunkLights) {
-            maxPointLights += lights.size();
-        }
+    void Materials::initialize(ArxDevice& device, const std::unordered_map<uint32_t, ChunkLightInfo>& infos, std::span<const PointLight> lights) {
+
+        // Room for edits before the buffers have to grow
+        maxPointLights = std::max(static_cast<uint32_t>(lights.size()) * 2, MIN_SLAB_SIZE);
+
+        // Baked ranges are packed, each slab is exactly its lights
+        chunkLightInfos = infos;
+        for (auto& [chunkID, info] : chunkLightInfos)
+            info.capacity = std::max(info.capacity, info.count);
+
+        pointLightsCPU.assign(lights.begin(), lights.end());
+        pointLightsCPU.resize(maxPointLights, PointLight{glm::vec3(0.0f), 0, glm::vec4(0.0f)});
 
-        pointLightBuffer = std::make_shared<ArxBuffer>(
+        currentPointLightCount = static_cast<uint32_t>(lights.size());
+        liveLightCount = currentPointLightCount;
+        freeSlabs.clear();
+
+        for (uint32_t i = 0; i < FRAMES; i++)
+            createBuffer(device, i);
+    }
+
+    void Materials::createBuffer(ArxDevice& device, uint32_t frameIndex) {
+        pointLightBuffers[frameIndex] = std::make_shared<ArxBuffer>(
             device,
             sizeof(PointLight),
             maxPointLights,
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        pointLightBuffer->map();
+        pointLightBuffers[frameIndex]->map();
 
-        // Fill buffer and set up chunkLightInfos
-        uint32_t offset = 0;
-        for (auto& [chunkID, lights] : chunkLights) {
-            ChunkLightInfo cli;
-            cli.offset = offset;
-            cli.count = static_cast<uint32_t>(lights.size());
-            chunkLightInfos[chunkID] = cli;
+        // The CPU copy is the source of truth, pending edits go up with it
+        if (currentPointLightCount > 0)
+            pointLightBuffers[frameIndex]->writeToBuffer(pointLightsCPU.data(), sizeof(PointLight) * currentPointLightCount, 0);
+        dirtyRanges[frameIndex].clear();
+    }
 
-            pointLightBuffer->writeToBuffer(lights.data(), lights.size() * sizeof(PointLight), offset * sizeof(PointLight));
-            offset += lights.size();
+    void Materials::addPointLightToChunk(uint32_t chunkID, const PointLight& pl) {
+        auto& cli = chunkLightInfos[chunkID];
+
+        // A full slab moves to one twice its size, amortized constant like a vector
+        if (cli.count == cli.capacity) {
+            const uint32_t capacity = std::max(cli.capacity * 2, MIN_SLAB_SIZE);
+            const uint32_t offset = allocateSlab(capacity);
+
+            std::copy_n(pointLightsCPU.begin() + cli.offset, cli.count, pointLightsCPU.begin() + offset);
+            markDirty(offset, cli.count);
+            if (cli.capacity > 0)
+                releaseSlab(cli.offset, cli.capacity);
+
+            cli.offset = offset;
+            cli.capacity = capacity;
         }
 
-        currentPointLightCount = maxPointLights;
+        const uint32_t slot = cli.offset + cli.count;
+        pointLightsCPU[slot] = pl;
+        markDirty(slot, 1);
+
+        cli.count++;
+        liveLightCount++;
     }
 
-    // Untested
-    void Materials::addPointLightToChunk(ArxDevice& device, uint32_t chunkID, PointLight& pl) {
-        if (currentPointLightCount >= maxPointLights) {
-            resizeBuffer(device, maxPointLights * 2);
+    void Materials::removePointLightFromChunk(uint32_t chunkID, const glm::vec3& lightPosition) {
+        auto it = chunkLightInfos.find(chunkID);
+        if (it == chunkLightInfos.end()) return;
+
+        auto& cli = it->second;
+        auto first = pointLightsCPU.begin() + cli.offset;
+        auto lightIt = std::find_if(first, first + cli.count,
+            [&lightPosition](const PointLight& light) {
+                return glm::distance(light.position, lightPosition) < 0.001f;
+            });
+
+        if (lightIt == first + cli.count) return;
+
+        // The chunk's last light takes the removed slot, its own slot becomes a tombstone
+        const uint32_t removeIndex = static_cast<uint32_t>(std::distance(pointLightsCPU.begin(), lightIt));
+        const uint32_t lastIndex = cli.offset + cli.count - 1;
+        pointLightsCPU[removeIndex] = pointLightsCPU[lastIndex];
+        pointLightsCPU[lastIndex].visibilityMask = 0;
+        markDirty(removeIndex, 1);
+        markDirty(lastIndex, 1);
+
+        cli.count--;
+        liveLightCount--;
+
+        if (cli.count == 0) {
+            releaseSlab(cli.offset, cli.capacity);
+            chunkLightInfos.erase(it);
         }
+    }
 
-        auto& cli = chunkLightInfos[chunkID];
-        uint32_t insertOffset = cli.offset + cli.count;
+    uint32_t Materials::allocateSlab(uint32_t capacity) {
+        auto slab = std::find_if(freeSlabs.begin(), freeSlabs.end(),
+            [capacity](const auto& free) { return free.second >= capacity; });
+
+        if (slab != freeSlabs.end()) {
+            const uint32_t offset = slab->first;
+            // The rest of a larger slab stays free
+            if (slab->second > capacity)
+                *slab = {offset + capacity, slab->second - capacity};
+            else
+                freeSlabs.erase(slab);
+            return offset;
+        }
 
-        // Shift lights after the insertion point
-        for (auto& [id, info] : chunkLightInfos) {
-            if (info.offset > insertOffset) {
-                shiftLights(info.offset, info.count, 1);
-                info.offset++;
-            }
+        // Only the CPU copy grows here, each frame's buffer is replaced in its own flush
+        const uint32_t offset = currentPointLightCount;
+        if (offset + capacity > maxPointLights) {
+            maxPointLights = std::max(maxPointLights * 2, offset + capacity);
+            pointLightsCPU.resize(maxPointLights, PointLight{glm::vec3(0.0f), 0, glm::vec4(0.0f)});
         }
 
-        // Insert new light
-        pointLightBuffer->writeToBuffer(&pl, sizeof(PointLight), insertOffset * sizeof(PointLight));
+        currentPointLightCount += capacity;
+        return offset;
+    }
 
-        cli.count++;
-        currentPointLightCount++;
+    void Materials::releaseSlab(uint32_t offset, uint32_t capacity) {
+        for (uint32_t i = offset; i < offset + capacity; ++i)
+            pointLightsCPU[i].visibilityMask = 0;
+        markDirty(offset, capacity);
+        freeSlabs.push_back({offset, capacity});
     }
 
-    // Untested
-    void Materials::removePointLightFromChunk(uint32_t chunkID, const glm::vec3& lightPosition) {
-        auto it = chunkLightInfos.find(chunkID);
-        if (it != chunkLightInfos.end()) {
-            auto& cli = it->second;
-            
-            std::vector<PointLight> chunkLights(cli.count);
-            pointLightBuffer->readFromBuffer(chunkLights.data(), cli.count * sizeof(PointLight), cli.offset * sizeof(PointLight));
-
-            auto lightIt = std::find_if(chunkLights.begin(), chunkLights.end(),
-                [&lightPosition](const PointLight& light) {
-                    return glm::distance(light.position, lightPosition) < 0.001f;
-                });
-
-            if (lightIt != chunkLights.end()) {
-                uint32_t removeIndex = static_cast<uint32_t>(cli.offset + std::distance(chunkLights.begin(), lightIt));
-
-                // Shift lights after the removal point
-                for (auto& [id, info] : chunkLightInfos) {
-                    if (info.offset > removeIndex) {
-                        shiftLights(info.offset, info.count, -1);
-                        info.offset--;
-                    }
-                }
-
-                cli.count--;
-                currentPointLightCount--;
-
-                if (cli.count == 0) {
-                    chunkLightInfos.erase(it);
-                }
+    void Materials::markDirty(uint32_t offset, uint32_t count) {
+        if (count == 0) return;
+
+        for (auto& ranges : dirtyRanges) {
+            // Most edits land next to the last one
+            if (!ranges.empty() && offset <= ranges.back().second && offset + count >= ranges.back().first) {
+                ranges.back().first = std::min(ranges.back().first, offset);
+                ranges.back().second = std::max(ranges.back().second, offset + count);
+                continue;
             }
+            ranges.push_back({offset, offset + count});
         }
     }
 
-    void Materials::resizeBuffer(ArxDevice& device, uint32_t newSize) {
-        VkDeviceSize newBufferSize = sizeof(PointLight);
+    void Materials::compact() {
+        std::vector<std::pair<uint32_t, ChunkLightInfo*>> slabs;
+        slabs.reserve(chunkLightInfos.size());
+        for (auto& [chunkID, info] : chunkLightInfos)
+            slabs.push_back({info.offset, &info});
+        std::sort(slabs.begin(), slabs.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Slabs only move towards the front, in offset order they never overwrite one that hasn't moved yet
+        uint32_t end = 0;
+        for (auto& [offset, info] : slabs) {
+            std::copy_n(pointLightsCPU.begin() + info->offset, info->count, pointLightsCPU.begin() + end);
+            info->offset = end;
+            info->capacity = info->count;
+            end += info->count;
+        }
 
-        auto newBuffer = std::make_shared<ArxBuffer>(
-            device,
-            newBufferSize,
-            newSize,
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        const uint32_t previousEnd = currentPointLightCount;
+        for (uint32_t i = end; i < previousEnd; ++i)
+            pointLightsCPU[i].visibilityMask = 0;
 
-        newBuffer->map();
+        freeSlabs.clear();
+        for (auto& ranges : dirtyRanges)
+            ranges.clear();
+        markDirty(0, previousEnd);
+        currentPointLightCount = end;
+    }
 
-        // Copy existing data to new buffer
-        VkDeviceSize copySize = sizeof(PointLight) * currentPointLightCount;
-        void* existingData = nullptr;
-        pointLightBuffer->readFromBuffer(&existingData, copySize, 0);
-        newBuffer->writeToBuffer(existingData, copySize, 0);
+    bool Materials::flush(ArxDevice& device, uint32_t frameIndex) {
+        if (!pointLightBuffers[frameIndex]) return false;
+        
+        if (currentPointLightCount > 2 * liveLightCount + MIN_SLAB_SIZE)
+            compact();
 
-        // Swap buffers
-        pointLightBuffer = std::move(newBuffer);
-        maxPointLights = newSize;
-    }
+        if (pointLightBuffers[frameIndex]->getInstanceCount() < maxPointLights) {
+            createBuffer(device, frameIndex);
+            ARX_LOG_INFO("Light buffer of frame {} grew to {} lights", frameIndex, maxPointLights);
+            return true;
+        }
+
+        auto& ranges = dirtyRanges[frameIndex];
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 0; i < ranges.size(); ) {
+            auto [begin, end] = ranges[i];
+            for (++i; i < ranges.size() && ranges[i].first <= end; ++i)
+                end = std::max(end, ranges[i].second);
 
-    void Materials::shiftLights(uint32_t startOffset, uint32_t count, int32_t shiftAmount) {
-        std::vector<PointLight> lights(count);
-        pointLightBuffer->readFromBuffer(lights.data(), count * sizeof(PointLight), startOffset * sizeof(PointLight));
-        pointLightBuffer->writeToBuffer(lights.data(), count * sizeof(PointLight), (startOffset + shiftAmount) * sizeof(PointLight));
+            pointLightBuffers[frameIndex]->writeToBuffer(pointLightsCPU.data() + begin, (end - begin) * sizeof(PointLight), begin * sizeof(PointLight));
+        }
+        ranges.clear();
+        return false;
     }
 
-    // Untested
     void Materials::updateBufferForChunk(uint32_t chunkID) {
         auto it = chunkLightInfos.find(chunkID);
-        if (it != chunkLightInfos.end()) {
-            auto& cli = it->second;
-            VkDeviceSize offset = cli.offset * sizeof(PointLight);
-            VkDeviceSize size = cli.count * sizeof(PointLight);
-            void* dataPtr = pointLightsCPU.data() + cli.offset;
-            pointLightBuffer->writeToBuffer(dataPtr, size, offset);
-        }
+        if (it != chunkLightInfos.end())
+            markDirty(it->second.offset, it->second.count);
     }
 
     void Materials::printLights() {
         std::cout << "==== Point Lights ====\n";
-        std::cout << "Total lights: " << currentPointLightCount << "\n\n";
-        
+        std::cout << "Total lights: " << liveLightCount << " in " << currentPointLightCount << " slots\n\n";
+
         for (const auto& [chunkID, cli] : chunkLightInfos) {
             std::cout << "Chunk ID: " << chunkID << "\n";
             std::cout << "Light count: " << cli.count << "\n";
 
-            std::vector<PointLight> chunkLights(cli.count);
-            pointLightBuffer->readFromBuffer(chunkLights.data(), cli.count * sizeof(PointLight), cli.offset * sizeof(PointLight));
+            std::span<const PointLight> chunkLights(pointLightsCPU.data() + cli.offset, cli.count);
 
             for (size_t i = 0; i < chunkLights.size(); ++i) {
                 const auto& light = chunkLights[i];
@@ -172,9 +239,15 @@ namespace arx {
 
 
     void Materials::cleanup() {
-        pointLightBuffer.reset();
+        for (auto& buffer : pointLightBuffers)
+            buffer.reset();
         pointLightsCPU.clear();
         chunkLightInfos.clear();
+        freeSlabs.clear();
+        for (auto& ranges : dirtyRanges)
+            ranges.clear();
+        maxPointLights = 0;
         currentPointLightCount = 0;
+        liveLightCount = 0;
     }
 }
@@ -1,56 +1,63 @@
 #pragma once
 
 #include "../source/arx_buffer.h"
+#include "../source/geometry/lightLayout.hpp"
+#include "../source/managers/arx_buffer_manager.hpp"
 
+#include <span>
 
-namespace arx {
-
-    struct PointLight {
-        glm::vec3 position;
-        uint32_t visibilityMask;
-        glm::vec4 color;
-    };
 
-    struct ChunkLightInfo {
-        uint32_t offset; // Offset in the buffer (in terms of PointLight instances)
-        uint32_t count;
-    };
+namespace arx {
 
     class Materials {
     public:
-                
-        static void addPointLight(const PointLight& pl);
-        static void removePointLight(const glm::vec3 keyPos);
-        
-        static void initialize(ArxDevice& device, std::unordered_map<uint32_t, std::vector<PointLight>>& chunkLights);
-        static void addPointLightToChunk(ArxDevice& device, uint32_t chunkID, PointLight& pl);
+        static constexpr uint32_t FRAMES = BufferManager::MAX_FRAMES_IN_FLIGHT;
+
+        static void initialize(ArxDevice& device, const std::unordered_map<uint32_t, ChunkLightInfo>& infos, std::span<const PointLight> lights);
+        // Constant time in the total light count, only the CPU copy changes until flush
+        static void addPointLightToChunk(uint32_t chunkID, const PointLight& pl);
         static void removePointLightFromChunk(uint32_t chunkID, const glm::vec3& lightPosition);
 
         static void updateBufferForChunk(uint32_t chunkID);
+        // Brings frameIndex's buffer up to the CPU copy, call it once that frame's fence has been waited on.
+        // Compacts first when tombstones are most of the used slots. Returns true when the buffer was replaced
+        // to make room, the frame's descriptor sets have to be pointed at the new one before recording
+        static bool flush(ArxDevice& device, uint32_t frameIndex);
+        static void compact();
         static void cleanup();
         static void printLights();
-        
-        // Buffer to store all point lights
-        static std::shared_ptr<ArxBuffer> pointLightBuffer;
+
+        // One buffer per frame in flight, edits never touch a buffer a frame still reads
+        static std::array<std::shared_ptr<ArxBuffer>, FRAMES> pointLightBuffers;
 
         // Mapping from chunkID to ChunkLightInfo
         static std::unordered_map<uint32_t, ChunkLightInfo> chunkLightInfos;
 
-        // Staging area in CPU
+        // CPU copy of the buffers, edits land here first
         static std::vector<PointLight> pointLightsCPU;
 
-        static uint32_t maxPointLights;
-        static uint32_t currentPointLightCount;
-        
+        static uint32_t maxPointLights;         // Capacity of the CPU copy, a frame's buffer catches up in flush
+        static uint32_t currentPointLightCount; // End of the slabs, the range the shaders go through
+
     private:
-        static void resizeBuffer(ArxDevice& device, uint32_t newSize);
-        static void shiftLights(uint32_t startOffset, uint32_t count, int32_t shiftAmount);
-        
+        static constexpr uint32_t MIN_SLAB_SIZE = 4;
+
+        // First fit from the released slabs, otherwise past the end of the used range
+        static uint32_t allocateSlab(uint32_t capacity);
+        static void releaseSlab(uint32_t offset, uint32_t capacity);
+        // Recorded for every frame, each frame's flush replays its own list
+        static void markDirty(uint32_t offset, uint32_t count);
+        static void createBuffer(ArxDevice& device, uint32_t frameIndex);
+
+        static std::vector<std::pair<uint32_t, uint32_t>>                       freeSlabs;   // offset, capacity
+        static std::array<std::vector<std::pair<uint32_t, uint32_t>>, FRAMES>   dirtyRanges; // begin, end
+        static uint32_t                                                         liveLightCount;
+
         glm::vec3 revertChunkID(uint32_t chunkID, uint32_t &chunkX, uint32_t &chunkY, uint32_t &chunkZ) {
             chunkX = chunkID & 0x3FF;
             chunkY = (chunkID >> 10) & 0x3FF;
             chunkZ = (chunkID >> 20) & 0x3FF;
-            
+
             return glm::vec3(chunkX, chunkY, chunkZ);
         }
     };
@@ -0,0 +1,49 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/chunkLod.hpp"
+
+namespace arx {
+
+    void ChunkLod::downsample(std::span<const InstanceData> instances, const glm::vec4& origin, uint32_t lod, std::vector<InstanceData>& coarse) {
+        constexpr uint32_t N = PackedInstance::MAX_LOCAL_POSITION + 1;
+
+        // (coarse cell, palette index, child), sorted so every cell's children are adjacent and grouped by color
+        std::vector<std::array<uint32_t, 3>> children;
+        children.reserve(instances.size());
+        for (uint32_t i = 0; i < instances.size(); ++i) {
+            const glm::uvec3 local = glm::uvec3(glm::round((glm::vec3(instances[i].translation) - glm::vec3(origin)) / origin.w));
+            const glm::uvec3 cell = local >> lod;
+            children.push_back({(cell.z * N + cell.y) * N + cell.x, instances[i].paletteIndex, i});
+        }
+        std::sort(children.begin(), children.end());
+
+        for (size_t first = 0; first < children.size(); ) {
+            const uint32_t cell = children[first][0];
+
+            uint32_t bestChild = children[first][2];
+            size_t bestCount = 0;
+            uint32_t emissive = 0;
+
+            size_t end = first;
+            for (size_t run = first; run < children.size() && children[run][0] == cell; ) {
+                size_t runEnd = run;
+                for (; runEnd < children.size() && children[runEnd][0] == cell && children[runEnd][1] == children[run][1]; ++runEnd)
+                    emissive |= instances[children[runEnd][2]].visibilityMask & (1u << 6);
+
+                if (runEnd - run > bestCount) {
+                    bestCount = runEnd - run;
+                    bestChild = children[run][2];
+                }
+                run = end = runEnd;
+            }
+
+            const glm::uvec3 local = glm::uvec3(cell % N, (cell / N) % N, cell / (N * N)) << lod;
+            InstanceData voxel = instances[bestChild];
+            voxel.translation = glm::vec4(glm::vec3(origin) + glm::vec3(local) * origin.w, 1.0f);
+            voxel.visibilityMask = 0x3F | emissive;
+            coarse.push_back(voxel);
+
+            first = end;
+        }
+    }
+}
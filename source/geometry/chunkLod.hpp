@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../../source/geometry/voxelTypes.hpp"
+
+#include <span>
+#include <vector>
+
+namespace arx {
+
+    // Coarser stand-ins for a chunk's voxels, the culling shaders draw them instead when a voxel covers only a few pixels
+    class ChunkLod {
+    public:
+        // Merges 2^lod voxels per axis into one, solid when any child is, with the most common palette index of its children.
+        // Coarse voxels are placed at their lowest child and keep an emissive child's bit, faces are left for the world pass
+        static void downsample(std::span<const InstanceData> instances,
+                               const glm::vec4& origin,
+                               uint32_t lod,
+                               std::vector<InstanceData>& coarse);
+    };
+}
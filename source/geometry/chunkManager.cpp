@@ -6,8 +6,10 @@
 #include "../source/arx_frame_info.h"
 #include "../source/arx_utils.h"
 
+#include <filesystem>
+
 namespace arx {
-    
+
     ChunkManager::ChunkManager(ArxDevice &device) : arxDevice{device} {}
 
     ChunkManager::~ChunkManager() {
@@ -19,215 +21,141 @@ namespace arx {
         int numChunksX = terrainSize.x / ADJUSTED_CHUNK;
         int numChunksY = terrainSize.y / ADJUSTED_CHUNK;
         int numChunksZ = terrainSize.z / ADJUSTED_CHUNK;
+        std::vector<glm::vec4> chunkOrigins;
 
         for (int x = 0; x < numChunksX; ++x) {
             for (int y = 0; y < numChunksY; ++y) {
                 for (int z = 0; z < numChunksZ; ++z) {
                     glm::vec3 chunkPosition(x * ADJUSTED_CHUNK, y * ADJUSTED_CHUNK, z * ADJUSTED_CHUNK);
-                    Chunk* newChunk = new Chunk(arxDevice, chunkPosition, voxel, terrainSize);
+                    Chunk* newChunk = new Chunk(arxDevice, chunkPosition, voxel, terrainSize, static_cast<uint32_t>(chunkOrigins.size()));
                     m_vpChunks.push_back(newChunk);
                     if (newChunk->getID() != -1) {
                         setChunkPosition({newChunk->getPosition(), newChunk->getID()});
                         setChunkAABB(newChunk->getPosition(), newChunk->getID());
+                        chunkOrigins.push_back(newChunk->getOrigin());
                     }
                 }
             }
         }
+        
+        BufferManager::createInstanceDecodeBuffers(arxDevice, chunkOrigins, Chunk::spongePalette());
+        BufferManager::createMeshBuffers(arxDevice, {}, {});
     }
 
-    const ogt_vox_scene* ChunkManager::loadVoxModel(const std::string& filepath) {
-        FILE* file = fopen(filepath.c_str(), "rb");
-        if (!file) {
-            // std::cerr << "Failed to open .vox file: " << filepath << std::endl;
-            ARX_LOG_ERROR("Failed to open the .vox file {}", filepath);
-            return nullptr;
-        }
-
-        fseek(file, 0, SEEK_END);
-        uint32_t bufferSize = static_cast<uint32_t>(ftell(file));
-        fseek(file, 0, SEEK_SET);
-
-        uint8_t* buffer = new uint8_t[bufferSize];
-        fread(buffer, bufferSize, 1, file);
-        fclose(file);
-
-        // Load the scene
-        const ogt_vox_scene* scene = ogt_vox_read_scene(buffer, bufferSize);
-        delete[] buffer;
-
-        if (!scene) {
-            std::cerr << "Failed to read .vox scene: " << filepath << std::endl;
-        }
-
-        return scene;
-    }
-
-    glm::mat4 ChunkManager::ogtTransformToMat4(const ogt_vox_transform& transform) {
-        return glm::mat4(
-            transform.m00, transform.m01, transform.m02, transform.m03,
-            transform.m10, transform.m11, transform.m12, transform.m13,
-            transform.m20, transform.m21, transform.m22, transform.m23,
-            transform.m30, transform.m31, transform.m32, transform.m33
-        );
-    }
-
-    bool ChunkManager::vox2Chunks(ArxGameObject::Map& voxel, const std::string& filepath) {
-        Timer::start();
-        const ogt_vox_scene* scene = loadVoxModel(filepath);
-        if (!scene) return false;
+    bool ChunkManager::vox2Chunks(ArxGameObject::Map& voxel, const std::string& filepath, bool verifyContents) {
+        const std::string cachePath = SceneCache::cachePathFor(filepath);
+        SourceStamp source;
+        bool hashed = false;
         
-        glm::mat4 worldPosMatrix = glm::mat4(1.f);
+        // Warm start, everything below is already baked in the cache next to the .vox
+        Timer::start();
+        const bool stamped = std::filesystem::exists(filepath) && SceneCache::stampFile(filepath, source);
+        bool cached = sceneCache.open(cachePath);
         
-        const std::array<glm::ivec3, 6> faceDirections = {
-            glm::ivec3(-1,  0,  0), // Left (negative X)
-            glm::ivec3( 1,  0,  0), // Right (positive X)
-            glm::ivec3( 0,  1,  0), // Bottom (positive Y)
-            glm::ivec3( 0, -1,  0), // Top (negative Y)
-            glm::ivec3( 0,  0,  1), // Back (positive Z)
-            glm::ivec3( 0,  0, -1)  // Front (negative Z)
-        };
+        // Scenes shipped baked without their .vox skip the source check
+        if (cached && stamped) {
+            const SourceStamp& baked = sceneCache.getSource();
+            cached = !verifyContents && baked.size == source.size && baked.writeTime == source.writeTime;
+            
+            // Copied or touched files get a new write time, reading the whole file is the fallback
+            if (!cached) {
+                hashed = SceneCache::hashFile(filepath, source.hash, source.size);
+                cached = hashed && baked.size == source.size && baked.hash == source.hash;
+                // Same contents, the next launch can go by the stamp again
+                if (cached && !verifyContents)
+                    SceneCache::restamp(cachePath, source);
+            }
+            if (!cached) {
+                ARX_LOG_INFO("Scene cache {} is stale, rebaking", cachePath);
+                sceneCache.close();
+            }
+        }
         
-        // Calculate world size
-        glm::vec3 worldSize(0.0f);
-        for (uint32_t instanceIndex = 0; instanceIndex < scene->num_instances; ++instanceIndex) {
-            const ogt_vox_instance* instance = &scene->instances[instanceIndex];
-            const ogt_vox_model* model = scene->models[instance->model_index];
-            glm::mat4 modelTransform = ogtTransformToMat4(instance->transform);
-            glm::vec3 maxBounds(model->size_x, model->size_y, model->size_z);
-            glm::vec4 transformedMax = modelTransform * glm::vec4(maxBounds, 1.0f);
-            worldSize = glm::max(worldSize, glm::vec3(transformedMax));
+        if (cached) {
+            const double openTime = Timer::stop();
+            
+            Timer::start();
+            uploadScene(voxel, sceneCache.getView());
+            const double uploadTime = Timer::stop();
+            
+            ARX_LOG_INFO("Loaded {} in {} ms, map {} ms, upload {} ms", cachePath, openTime + uploadTime, openTime, uploadTime);
+            ARX_LOG_INFO("Number of lights: {}", sceneCache.getView().areaLights);
+            return true;
         }
+        const double checkTime = Timer::stop();
         
-        // Create SVO
-        svo = std::make_unique<SVO>(worldSize, CHUNK_SIZE);
-        std::unordered_map<uint32_t, std::vector<PointLight>> chunkLights;
+        BakedScene baked;
+        BakeStats stats;
+        if (!VoxBaker::bake(filepath, arxDevice.threadPool, baked, svo, stats)) return false;
         
-        int areaLights = 0;
-
-        for (uint32_t instanceIndex = 0; instanceIndex < scene->num_instances; ++instanceIndex) {
-            
-            const ogt_vox_instance* instance = &scene->instances[instanceIndex];
-            const ogt_vox_model* model = scene->models[instance->model_index];
-
-            glm::mat4 modelTransform = ogtTransformToMat4(instance->transform);
-            glm::vec3 maxBounds(model->size_x, model->size_y, model->size_z);
+        Timer::start();
+        uploadScene(voxel, baked);
+        const double uploadTime = Timer::stop();
+        
+        ARX_LOG_INFO("Load {} ms, occupancy {} ms, tiles {} ms on {} threads, merge {} ms, world faces {} ms, mesh {} ms, lod {} ms, upload {} ms",
+                     stats.loadTime, stats.occupancyTime, stats.tileTime, stats.threadCount, stats.mergeTime, stats.faceTime, stats.meshTime, stats.lodTime, uploadTime);
+        ARX_LOG_INFO("Faces hidden across instances: {}", stats.hiddenFaces);
+        ARX_LOG_INFO("Greedy meshing merged {} visible faces into {} quads", stats.visibleFaces, stats.meshQuads);
+        ARX_LOG_INFO("Chunk LODs: {} full resolution instances, {} at 2x and {} at 4x", baked.instances.size(), stats.lodInstances[0], stats.lodInstances[1]);
+        ARX_LOG_INFO("Took {} ms", checkTime + stats.totalTime() + uploadTime);
+        ARX_LOG_INFO("Number of lights: {}", baked.areaLights);
+        
+        if (stamped && (hashed || SceneCache::hashFile(filepath, source.hash, source.size))) {
+            Timer::start();
+            if (SceneCache::write(cachePath, baked, source))
+                ARX_LOG_INFO("Baked {} in {} ms", cachePath, Timer::stop());
+        }
 
-            int numChunksX = static_cast<int>(std::ceil(maxBounds.x / CHUNK_SIZE));
-            int numChunksY = static_cast<int>(std::ceil(maxBounds.y / CHUNK_SIZE));
-            int numChunksZ = static_cast<int>(std::ceil(maxBounds.z / CHUNK_SIZE));
+        return true;
+    }
 
-            std::vector<std::vector<std::vector<std::vector<InstanceData>>>> chunks(numChunksX,
-                std::vector<std::vector<std::vector<InstanceData>>>(numChunksY,
-                    std::vector<std::vector<InstanceData>>(numChunksZ, std::vector<InstanceData>())));
+    void ChunkManager::uploadScene(ArxGameObject::Map& voxel, const BakedSceneView& scene) {
+        worldSize = scene.worldSize;
+        std::vector<glm::vec4> chunkOrigins;
+        chunkOrigins.reserve(scene.chunks.size());
+        
+        for (const BakedChunk& chunk : scene.chunks) {
+            // Each chunk's instance buffer holds its LODs back to back, the culling shaders offset into it per LOD
+            const auto instances = scene.chunkInstances(chunk);
+            const auto lodInstances = scene.chunkLodInstances(chunk);
+            std::vector<PackedInstance> chunkInstances(instances.begin(), instances.end());
+            chunkInstances.insert(chunkInstances.end(), lodInstances.begin(), lodInstances.end());
             
-            // Initialize voxelWorld with the correct dimensions
-            voxelWorld.resize(model->size_x,
-                std::vector<std::vector<VoxelData>>(model->size_y,
-                    std::vector<VoxelData>(model->size_z, {0, true})));
+            Chunk* newChunk = new Chunk(arxDevice, chunk.position, voxel, chunkInstances, chunk.origin,
+                                        {chunk.instanceCount, chunk.lodCounts[0], chunk.lodCounts[1]});
+            chunkOrigins.push_back(chunk.origin);
             
-            // First pass: Populate the voxelWorld array
-            for (uint32_t voxelX = 0; voxelX < model->size_x; ++voxelX) {
-                for (uint32_t voxelY = 0; voxelY < model->size_y; ++voxelY) {
-                    for (uint32_t voxelZ = 0; voxelZ < model->size_z; ++voxelZ) {
-                        uint32_t colorIndex = model->voxel_data[voxelX + (voxelY * model->size_x) + (voxelZ * model->size_x * model->size_y)];
-                        voxelWorld[voxelX][voxelY][voxelZ] = {colorIndex, colorIndex == 0}; // 3D representation includes air voxels
-                    }
-                }
-            }
-
-            for (uint32_t voxelX = 0; voxelX < model->size_x; ++voxelX) {
-                for (uint32_t voxelY = 0; voxelY < model->size_y; ++voxelY) {
-                    for (uint32_t voxelZ = 0; voxelZ < model->size_z; ++voxelZ) {
-                        uint32_t colorIndex = model->voxel_data[voxelX + (voxelY * model->size_x) + (voxelZ * model->size_x * model->size_y)];
-                        if (colorIndex != 0) {
-                            glm::vec4 position(voxelX, voxelY, voxelZ, 1.0f);
-                            glm::vec4 worldPosition = modelTransform * position; // Transform to world space
-                            glm::vec4 color = glm::vec4(scene->palette.color[colorIndex].r / 255.0f,
-                                                        scene->palette.color[colorIndex].g / 255.0f,
-                                                        scene->palette.color[colorIndex].b / 255.0f,
-                                                        /*scene->materials.matl[colorIndex].spec*/0.5f);
-                            
-                            int chunkX = voxelX / CHUNK_SIZE;
-                            int chunkY = voxelY / CHUNK_SIZE;
-                            int chunkZ = voxelZ / CHUNK_SIZE;
-                            
-                            uint32_t visibilityMask = 0x3F; // All faces visible by default
-
-                            for (int i = 0; i < 6; ++i) {
-                                glm::ivec3 neighborPos(voxelX + faceDirections[i].x,
-                                                       voxelY + faceDirections[i].y,
-                                                       voxelZ + faceDirections[i].z);
-                                
-                                // Check if the neighboring voxel is within bounds and not air
-                                if (neighborPos.x >= 0 && neighborPos.x < model->size_x &&
-                                    neighborPos.y >= 0 && neighborPos.y < model->size_y &&
-                                    neighborPos.z >= 0 && neighborPos.z < model->size_z &&
-                                    !voxelWorld[neighborPos.x][neighborPos.y][neighborPos.z].isAir) {
-                                    // If there's a solid voxel in this direction, hide this face
-                                    visibilityMask &= ~(1u << i);
-                                }
-                            }
-                            
-                            ogt_matl_type mat = scene->materials.matl[colorIndex].type;
-                            if (mat == 3) { // Emit
-                                // Values of 0-1023 for each direction, otherwise I need more than 32bits
-                                uint32_t chunkID = (chunkX & 0x3FF) | ((chunkY & 0x3FF) << 10) | ((chunkZ & 0x3FF) << 20);
-                                
-                                PointLight light;
-                                light.position = glm::vec3(worldPosition);
-                                light.color = color;
-                                light.visibilityMask = visibilityMask;
-                                visibilityMask |= (1u << 6);
-                                areaLights += std::popcount(visibilityMask);
-                                chunkLights[chunkID].push_back(light);
-                            }
-        
-                            chunks[chunkX][chunkY][chunkZ].push_back({worldPosition, color, visibilityMask});
-                        }
-                    }
-                }
-            }
-
-            for (int x = 0; x < numChunksX; ++x) {
-                for (int y = 0; y < numChunksY; ++y) {
-                    for (int z = 0; z < numChunksZ; ++z) {
-                        if (!chunks[x][y][z].empty()) {
-                            glm::vec3 chunkPosition = glm::vec3(worldPosMatrix * modelTransform * glm::vec4(x * CHUNK_SIZE, y * CHUNK_SIZE, z * CHUNK_SIZE, 1.0f));
-                            
-                            svo->insertChunk(chunkPosition, chunks[x][y][z]);
-                            
-                            Chunk* newChunk = new Chunk(arxDevice, chunkPosition, voxel, chunks[x][y][z]);
-                            
-                            m_vpChunks.push_back(newChunk);
-                            if (newChunk->getID() != -1) {
-                                setChunkPosition({newChunk->getPosition(), newChunk->getID()});
-                                setChunkAABB(newChunk->getPosition(), newChunk->getID());
-                            }
-                        }
-                    }
-                }
+            m_vpChunks.push_back(newChunk);
+            if (newChunk->getID() != -1) {
+                setChunkPosition({newChunk->getPosition(), newChunk->getID()});
+                chunkAABBs[newChunk->getID()] = AABB{chunk.aabbMin, chunk.aabbMax};
+                chunkMeshes[newChunk->getID()] = ChunkMesh{chunk.firstIndex, chunk.indexCount, chunk.vertexOffset};
             }
         }
         
-        // Set a dummy light for scenes with no light
-        // My system doesn't support nulldescriptors
-        
-        PointLight light;
-        light.position = glm::vec3(0,0,0);
-        light.color = glm::vec4(1);
-        light.visibilityMask = 0;
+        std::unordered_map<uint32_t, ChunkLightInfo> lightInfos;
+        for (const BakedLightRange& range : scene.lightRanges)
+            lightInfos[range.chunkID] = {range.offset, range.count};
         
-        if (chunkLights.size() == 0) chunkLights[0].push_back(light);
-        if (chunkLights.size() > 0)
-            Materials::initialize(arxDevice, chunkLights);
-        BufferManager::createSVOBuffers(arxDevice, svo->getNodes(), svo->getVoxels());
-
-        ogt_vox_destroy_scene(scene);
-
-        ARX_LOG_INFO("Took {} ms", Timer::stop());
-        ARX_LOG_INFO("Number of lights: {}", areaLights);
+        Materials::initialize(arxDevice, lightInfos, scene.lights);
+        BufferManager::createInstanceDecodeBuffers(arxDevice, chunkOrigins, scene.palette);
+        BufferManager::createMeshBuffers(arxDevice, scene.meshVertices, scene.meshIndices);
+    }
 
-        return true;
+    SVO& ChunkManager::editableSVO() const {
+        // A warm start skips the tree, it's rebuilt from the baked chunks the first time it's edited
+        if (!svo) {
+            const BakedSceneView& scene = sceneCache.getView();
+            svo = std::make_unique<SVO>(worldSize, CHUNK_SIZE);
+            for (const BakedChunk& chunk : scene.chunks) {
+                std::vector<InstanceData> instances;
+                instances.reserve(chunk.instanceCount);
+                for (const PackedInstance& instance : scene.chunkInstances(chunk))
+                    instances.push_back(instance.unpack(chunk.origin, scene.palette));
+                svo->insertChunk(chunk.position, instances);
+            }
+        }
+        return *svo;
     }
 
     void ChunkManager::setChunkPosition(const std::pair<glm::vec3, unsigned int>& position) {
@@ -243,18 +171,18 @@ namespace arx {
     }
 
     void ChunkManager::addVoxel(const glm::vec3& worldPosition, const InstanceData& voxelData) {
-        svo->addVoxel(worldPosition, voxelData);
+        editableSVO().addVoxel(worldPosition, voxelData);
         // Update corresponding Chunk object if necessary
         // Update rendering data
     }
 
     void ChunkManager::removeVoxel(const glm::vec3& worldPosition) {
-        svo->removeVoxel(worldPosition);
+        editableSVO().removeVoxel(worldPosition);
         // Update corresponding Chunk object if necessary
         // Update rendering data
     }
 
     const InstanceData* ChunkManager::getVoxel(const glm::vec3& worldPosition) const {
-        return svo->getVoxel(worldPosition);
+        return editableSVO().getVoxel(worldPosition);
     }
 }
@@ -4,8 +4,9 @@
 #include "../../source/arx_pipeline.h"
 #include "../../source/arx_camera.h"
 #include "../../source/arx_model.h"
-
-#include "../../libs/ogt_vox.h"
+#include "../../source/geometry/blockMaterials.hpp"
+#include "../../source/geometry/sceneCache.hpp"
+#include "../../source/geometry/voxBaker.hpp"
 
 namespace arx {
 
@@ -13,9 +14,11 @@ namespace arx {
     class SVO;
     class Materials;
 
-    struct VoxelData {
-        uint32_t colorIndex;
-        bool isAir;
+    // Range of a chunk's greedy mesh in BufferManager::meshIndexBuffer/meshVertexBuffer
+    struct ChunkMesh {
+        uint32_t    firstIndex{0};
+        uint32_t    indexCount{0};
+        int32_t     vertexOffset{0};
     };
 
     class ChunkManager {
@@ -29,10 +32,13 @@ namespace arx {
         void MengerSponge(ArxGameObject::Map& voxel, const glm::ivec3& terrainSize);
         void setChunkAABB(const glm::vec3& position, const unsigned int chunkId);
         
-        bool vox2Chunks(ArxGameObject::Map& voxel, const std::string& filepath);
+        // Loads the baked .arxscene next to filepath when it is up to date, otherwise bakes the .vox and writes one.
+        // Up to date is a matching size and write time, or a matching content hash when those differ or verifyContents is set
+        bool vox2Chunks(ArxGameObject::Map& voxel, const std::string& filepath, bool verifyContents = false);
         
         const std::vector<std::pair<glm::vec3, unsigned int>>& getPositions() const { return chunkPositions; }
         const std::unordered_map<unsigned int, AABB>& getChunkAABBs() const { return chunkAABBs; }
+        const std::unordered_map<unsigned int, ChunkMesh>& getChunkMeshes() const { return chunkMeshes; }
         
         // SVO related
         void addVoxel(const glm::vec3& worldPosition, const InstanceData& voxelData);
@@ -45,15 +51,17 @@ namespace arx {
         ArxDevice                                               &arxDevice;
         std::vector<Chunk*>                                     m_vpChunks; // All the Chunk instances
         std::unordered_map<unsigned int, AABB>                  chunkAABBs; // The world space AABB min and max of each chunk
+        std::unordered_map<unsigned int, ChunkMesh>             chunkMeshes; // Only baked scenes are meshed
         ArxCamera                                               camera;
         std::vector<std::pair<glm::vec3, unsigned int>>         chunkPositions; // World space positions of chunks
-        std::vector<std::vector<std::vector<VoxelData>>>        voxelWorld; // A 3D representation of each voxel including the air voxels
+        glm::vec3                                               worldSize{0.0f};
+        SceneCache                                              sceneCache; // Kept mapped so the SVO can be rebuilt lazily
 
                 
-        const ogt_vox_scene* loadVoxModel(const std::string& filepath);
         void setChunkPosition(const std::pair<glm::vec3, unsigned int>& position);
-        glm::mat4 ogtTransformToMat4(const ogt_vox_transform& transform);
+        void uploadScene(ArxGameObject::Map& voxel, const BakedSceneView& scene);
+        SVO& editableSVO() const;
         
-        std::unique_ptr<SVO>                                    svo;
+        mutable std::unique_ptr<SVO>                            svo;
     };
 }
@@ -3,10 +3,11 @@
 #include "../source/geometry/chunks.h"
 
 namespace arx {
-    Chunk::Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, glm::ivec3 terrainSize) : position{pos} {
+    Chunk::Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, glm::ivec3 terrainSize, uint32_t chunkIndex)
+    : position{pos}, origin{pos, VOXEL_SIZE} {
         initializeBlocks();
 
-        std::vector<InstanceData> tmpInstance;
+        std::vector<PackedInstance> tmpInstance;
         applyCARule(terrainSize);
         tmpInstance.resize(instances);
 
@@ -16,17 +17,23 @@ namespace arx {
                 for (int z = 0; z < ADJUSTED_CHUNK; z++) {
                     if (!blocks[x][y][z].isActive()) continue;
                     glm::vec3 translation = glm::vec3(x*VOXEL_SIZE, y*VOXEL_SIZE, z*VOXEL_SIZE) + position;
-                    tmpInstance[instances].color = glm::vec4(colors[x][y][z], 1.0f);
-                    tmpInstance[instances].translation = glm::vec4(translation, 1.0f);
+                    glm::uvec3 rgb = glm::uvec3(glm::round(colors[x][y][z] * glm::vec3(7.0f, 7.0f, 3.0f)));
+                    
+                    InstanceData instance{};
+                    instance.translation = glm::vec4(translation, 1.0f);
+                    instance.paletteIndex = (rgb.r << 5) | (rgb.g << 2) | rgb.b;
+                    tmpInstance[instances] = PackedInstance::pack(instance, chunkIndex, origin);
                     instances++;
                 }
             }
         }
 
 //        std::cout << "Instances drawn: " << instances << std::endl;
+        lodCounts[0] = instances;
         if (instances > 0)
         {
             std::shared_ptr<ArxModel> cubeModel = ArxModel::createModelFromFile(device, "data/models/cube.obj", instances, tmpInstance);
+            ArxModel::calculateWorldDimensions(tmpInstance.back().unpack(origin, {}).translation);
             auto cube = ArxGameObject::createGameObject();
             cube.model = cubeModel;
             id = cube.getId();
@@ -35,18 +42,71 @@ namespace arx {
         }
     }
 
-    Chunk::Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, const std::vector<InstanceData>& instanceDataVec) : position{pos} {
+    Chunk::Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, const std::vector<PackedInstance>& instanceDataVec, const glm::vec4& origin,
+                 const std::array<uint32_t, PackedInstance::LOD_COUNT>& lodCounts)
+    : position{pos}, origin{origin}, lodCounts{lodCounts} {
         instances = static_cast<uint32_t>(instanceDataVec.size());
+        assert(instances == std::accumulate(lodCounts.begin(), lodCounts.end(), 0u) && "LOD counts do not add up to the instances");
         
-        if (instances > 0)
+        if (lodCounts[0] > 0)
         {
-            std::shared_ptr<ArxModel> cubeModel = ArxModel::createModelFromFile(device, "data/models/cube.obj", instances, instanceDataVec);
+            ArxModel::calculateWorldDimensions(instanceDataVec[lodCounts[0] - 1].unpack(origin, {}).translation);
+            
+            std::vector<PackedInstance> brickInstances = instanceDataVec;
+            buildBricks(brickInstances);
+            
+            std::shared_ptr<ArxModel> cubeModel = ArxModel::createModelFromFile(device, "data/models/cube.obj", instances, brickInstances);
             auto cube = ArxGameObject::createGameObject();
             id = cube.getId();
             cube.model = cubeModel;
             voxel.emplace(id, std::move(cube));
-            instanceData[id] = instanceDataVec;
+            instanceData[id] = std::move(brickInstances);
+        }
+    }
+
+    void Chunk::buildBricks(std::vector<PackedInstance>& instanceDataVec) {
+        constexpr uint32_t bricksPerAxis = (PackedInstance::MAX_LOCAL_POSITION + 1) / BRICK_SIZE;
+        constexpr uint32_t brickCount = bricksPerAxis * bricksPerAxis * bricksPerAxis;
+        
+        auto brickOf = [](const PackedInstance& instance) {
+            const glm::uvec3 brick = (glm::uvec3(instance.data, instance.data >> 4, instance.data >> 8) & glm::uvec3(PackedInstance::MAX_LOCAL_POSITION)) / BRICK_SIZE;
+            return brick.x + (brick.y + brick.z * bricksPerAxis) * bricksPerAxis;
+        };
+        
+        // Counting sort of the full resolution range, the LODs after it keep their order
+        std::array<uint32_t, brickCount + 1> offsets{};
+        for (uint32_t i = 0; i < lodCounts[0]; i++)
+            offsets[brickOf(instanceDataVec[i]) + 1]++;
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        
+        std::vector<PackedInstance> sorted(lodCounts[0]);
+        std::array<uint32_t, brickCount> heads{};
+        std::copy(offsets.begin(), offsets.end() - 1, heads.begin());
+        for (uint32_t i = 0; i < lodCounts[0]; i++)
+            sorted[heads[brickOf(instanceDataVec[i])]++] = instanceDataVec[i];
+        std::copy(sorted.begin(), sorted.end(), instanceDataVec.begin());
+        
+        bricks.clear();
+        for (uint32_t brick = 0; brick < brickCount; brick++) {
+            if (offsets[brick] == offsets[brick + 1]) continue;
+            
+            Brick b{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()), offsets[brick], offsets[brick + 1] - offsets[brick]};
+            for (uint32_t i = offsets[brick]; i < offsets[brick + 1]; i++) {
+                // The G-pass cube spans VOXEL_SIZE either side of the translation
+                const glm::vec3 translation = glm::vec3(instanceDataVec[i].unpack(origin, {}).translation);
+                b.min = glm::min(b.min, translation - glm::vec3(VOXEL_SIZE));
+                b.max = glm::max(b.max, translation + glm::vec3(VOXEL_SIZE));
+            }
+            bricks.push_back(b);
+        }
+    }
+
+    std::vector<glm::vec4> Chunk::spongePalette() {
+        std::vector<glm::vec4> palette(256);
+        for (uint32_t i = 0; i < palette.size(); ++i) {
+            palette[i] = glm::vec4((i >> 5) / 7.0f, ((i >> 2) & 7) / 7.0f, (i & 3) / 3.0f, 1.0f);
         }
+        return palette;
     }
 
     void Chunk::initializeBlocks() {
@@ -13,8 +13,21 @@ namespace arx {
     
     class Chunk {
     public:
-        Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, glm::ivec3 terrainSize);
-        Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, const std::vector<InstanceData>& instanceDataVec);
+        static constexpr uint32_t BRICK_SIZE = 4; // Voxels per axis, a chunk holds up to 64 bricks
+        
+        // Full resolution voxels of one brick, a range of the chunk's instances the culling can draw on its own
+        struct Brick {
+            glm::vec3 min; // Bounds of its voxel cubes
+            glm::vec3 max;
+            uint32_t firstInstance; // From the chunk's first instance
+            uint32_t instanceCount;
+        };
+        
+        Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, glm::ivec3 terrainSize, uint32_t chunkIndex);
+        // origin: xyz origin the instances are packed against, w voxel step.
+        // instanceDataVec holds every LOD back to back, lodCounts[i] instances each, full resolution first
+        Chunk(ArxDevice &device, const glm::vec3& pos, ArxGameObject::Map& voxel, const std::vector<PackedInstance>& instanceDataVec, const glm::vec4& origin,
+              const std::array<uint32_t, PackedInstance::LOD_COUNT>& lodCounts);
         ~Chunk();
 
         void Update();
@@ -22,6 +35,12 @@ namespace arx {
         glm::vec3 getPosition() const { return position; }
         unsigned int getID() const { return id; }
         uint32_t getInstanceCount() const { return instances; }
+        const std::array<uint32_t, PackedInstance::LOD_COUNT>& getLodCounts() const { return lodCounts; }
+        const glm::vec4& getOrigin() const { return origin; }
+        const std::vector<Brick>& getBricks() const { return bricks; }
+        
+        // 3-3-2 RGB palette the Menger sponge colors are quantized to
+        static std::vector<glm::vec4> spongePalette();
         
         void applyCARule(glm::ivec3 terrainSize);
         glm::vec3 determineColorBasedOnPosition(glm::vec3 voxelGlobalPos, glm::ivec3 terrainSize);
@@ -33,10 +52,15 @@ namespace arx {
         std::unique_ptr<std::unique_ptr<std::unique_ptr<glm::vec3[]>[]>[]>  colors;
         
         glm::vec3                                                           position;
-        std::map<unsigned int, std::vector<InstanceData>>                   instanceData;
-        uint32_t                                                            instances = 0;
+        glm::vec4                                                           origin{0.0f};
+        std::map<unsigned int, std::vector<PackedInstance>>                 instanceData;
+        uint32_t                                                            instances = 0; // All LODs
+        std::array<uint32_t, PackedInstance::LOD_COUNT>                     lodCounts{}; // The sponge only has full resolution voxels
         unsigned int                                                        id = -1;
+        std::vector<Brick>                                                  bricks; // Empty for the sponge
 
         void initializeBlocks();
+        // Sorts the full resolution instances by brick and records the ranges
+        void buildBricks(std::vector<PackedInstance>& instanceDataVec);
     };
 }
@@ -0,0 +1,87 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/greedyMesher.hpp"
+
+namespace arx {
+
+    void GreedyMesher::meshChunk(std::span<const PackedInstance> instances, std::vector<uint32_t>& vertices, std::vector<uint32_t>& indices) {
+        static_assert(CHUNK_SIZE <= PackedInstance::MAX_LOCAL_POSITION, "Quad corners have to fit in 4 bits per axis");
+        constexpr uint32_t N = CHUNK_SIZE;
+
+        auto cellIndex = [](const glm::uvec3& p) { return (p.z * N + p.y) * N + p.x; };
+
+        // Palette index + 1 of every visible face, 0 where the face is hidden or the cell is air
+        std::array<std::array<uint16_t, N * N * N>, FACE_COUNT> faces{};
+        for (const PackedInstance& instance : instances) {
+            const glm::uvec3 local = glm::uvec3(instance.data, instance.data >> 4, instance.data >> 8) & glm::uvec3(PackedInstance::MAX_LOCAL_POSITION);
+            assert(glm::all(glm::lessThan(local, glm::uvec3(N))) && "Voxel is outside of its chunk");
+
+            const uint32_t mask = (instance.data >> 12) & 0x3F;
+            const uint16_t color = static_cast<uint16_t>(((instance.data >> 19) & 0xFF) + 1);
+            for (uint32_t face = 0; face < FACE_COUNT; ++face) {
+                if (mask & (1u << face)) faces[face][cellIndex(local)] = color;
+            }
+        }
+
+        std::array<uint16_t, N * N> slice;
+        for (uint32_t face = 0; face < FACE_COUNT; ++face) {
+            const uint32_t axis = face / 2; // FACE_NEG_X/POS_X, POS_Y/NEG_Y, POS_Z/NEG_Z
+            const uint32_t u = (axis + 1) % 3;
+            const uint32_t v = (axis + 2) % 3;
+            const bool positive = faceDirections()[face][axis] > 0;
+
+            for (uint32_t depth = 0; depth < N; ++depth) {
+                glm::uvec3 cell;
+                cell[axis] = depth;
+                for (uint32_t j = 0; j < N; ++j) {
+                    for (uint32_t i = 0; i < N; ++i) {
+                        cell[u] = i;
+                        cell[v] = j;
+                        slice[j * N + i] = faces[face][cellIndex(cell)];
+                    }
+                }
+
+                for (uint32_t j = 0; j < N; ++j) {
+                    for (uint32_t i = 0; i < N; ) {
+                        const uint16_t color = slice[j * N + i];
+                        if (color == 0) { ++i; continue; }
+
+                        // Widen along u, then grow along v while the whole row matches
+                        uint32_t width = 1;
+                        while (i + width < N && slice[j * N + i + width] == color) ++width;
+
+                        uint32_t height = 1;
+                        for (; j + height < N; ++height) {
+                            bool rowMatches = true;
+                            for (uint32_t k = 0; k < width && rowMatches; ++k)
+                                rowMatches = slice[(j + height) * N + i + k] == color;
+                            if (!rowMatches) break;
+                        }
+
+                        for (uint32_t h = 0; h < height; ++h)
+                            std::fill_n(&slice[(j + h) * N + i], width, uint16_t(0));
+
+                        // u x v is +axis, so this order faces outward on positive faces and is reversed on negative ones
+                        std::array<glm::uvec3, 4> corners;
+                        const glm::uvec2 quad[4] = {{i, j}, {i + width, j}, {i + width, j + height}, {i, j + height}};
+                        for (uint32_t c = 0; c < 4; ++c) {
+                            corners[c][axis] = depth + (positive ? 1 : 0);
+                            corners[c][u] = quad[c].x;
+                            corners[c][v] = quad[c].y;
+                        }
+                        if (!positive) std::swap(corners[1], corners[3]);
+
+                        const uint32_t base = static_cast<uint32_t>(vertices.size());
+                        for (const glm::uvec3& corner : corners)
+                            vertices.push_back(packVertex(corner, face, color - 1u));
+
+                        for (uint32_t index : {0u, 1u, 2u, 0u, 2u, 3u})
+                            indices.push_back(base + index);
+
+                        i += width;
+                    }
+                }
+            }
+        }
+    }
+}
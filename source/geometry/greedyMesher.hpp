@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../../source/geometry/voxelTypes.hpp"
+#include "../../source/geometry/occupancyGrid.hpp"
+
+#include <span>
+#include <vector>
+
+namespace arx {
+
+    // Merges the visible faces of a chunk into quads, per face direction and 2D slice, over runs of one palette index.
+    // Vertices are pulled by gbuffer_mesh.vert, bits 0-11 corner position in voxel steps from the chunk origin
+    // (4 bits per axis, corners go up to CHUNK_SIZE), 12-14 VoxelFace, 15-22 palette index
+    class GreedyMesher {
+    public:
+        static uint32_t packVertex(const glm::uvec3& corner, uint32_t face, uint32_t paletteIndex) {
+            return corner.x | (corner.y << 4) | (corner.z << 8) | (face << 12) | ((paletteIndex & 0xFF) << 15);
+        }
+
+        // Appends the quads of one chunk, indices are relative to the chunk's first vertex
+        static void meshChunk(std::span<const PackedInstance> instances,
+                              std::vector<uint32_t>& vertices,
+                              std::vector<uint32_t>& indices);
+    };
+}
@@ -0,0 +1,98 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/lightLayout.hpp"
+#include "../source/geometry/occupancyGrid.hpp"
+
+namespace arx {
+
+    void LightLayout::pack(const std::unordered_map<uint32_t, std::vector<PointLight>>& chunkLights,
+                           std::unordered_map<uint32_t, ChunkLightInfo>& infos,
+                           std::vector<PointLight>& lights) {
+        size_t totalLights = 0;
+        for (const auto& [chunkID, chunk] : chunkLights) {
+            totalLights += chunk.size();
+        }
+        
+        infos.clear();
+        lights.clear();
+        lights.reserve(totalLights);
+
+        // Lights of a chunk are contiguous, chunkLightInfos points at each run
+        for (const auto& [chunkID, chunk] : chunkLights) {
+            ChunkLightInfo cli;
+            cli.offset = static_cast<uint32_t>(lights.size());
+            cli.count = static_cast<uint32_t>(chunk.size());
+            infos[chunkID] = cli;
+
+            lights.insert(lights.end(), chunk.begin(), chunk.end());
+        }
+    }
+
+    void LightLayout::mergeEmissiveFaces(std::vector<PointLight>& lights) {
+        // Face, plane along the face axis and color. Ordered so the merged lights come out the same every bake
+        using PlaneKey = std::tuple<uint32_t, int32_t, float, float, float, float>;
+        std::map<PlaneKey, std::set<std::pair<int32_t, int32_t>>> planes; // (v, u) cells
+        
+        for (const PointLight& light : lights) {
+            const glm::ivec3 cell = glm::ivec3(glm::round(light.position));
+            for (uint32_t face = 0; face < FACE_COUNT; ++face) {
+                if ((light.visibilityMask & (1u << face)) == 0) continue;
+                
+                const uint32_t axis = face / 2;
+                const PlaneKey key{face, cell[axis], light.color.r, light.color.g, light.color.b, light.color.a};
+                planes[key].insert({cell[(axis + 2) % 3], cell[(axis + 1) % 3]});
+            }
+        }
+        
+        std::vector<PointLight> merged;
+        std::map<std::tuple<int32_t, int32_t, int32_t>, PointLight> singles; // Faces that didn't merge, by voxel
+        
+        for (auto& [key, cells] : planes) {
+            const auto& [face, plane, r, g, b, a] = key;
+            const uint32_t axis = face / 2;
+            const uint32_t axisU = (axis + 1) % 3;
+            const uint32_t axisV = (axis + 2) % 3;
+            
+            // Grow along u, then add rows along v while the whole span is there
+            while (!cells.empty()) {
+                const auto [v0, u0] = *cells.begin();
+                
+                int32_t u1 = u0;
+                while (cells.count({v0, u1 + 1})) ++u1;
+                
+                int32_t v1 = v0;
+                for (bool full = true; full; ) {
+                    for (int32_t u = u0; u <= u1 && full; ++u)
+                        full = cells.count({v1 + 1, u}) != 0;
+                    if (full) ++v1;
+                }
+                
+                for (int32_t v = v0; v <= v1; ++v)
+                    for (int32_t u = u0; u <= u1; ++u)
+                        cells.erase({v, u});
+                
+                glm::vec3 position;
+                position[axis] = static_cast<float>(plane);
+                position[axisU] = (u0 + u1) * 0.5f;
+                position[axisV] = (v0 + v1) * 0.5f;
+                
+                if (u0 == u1 && v0 == v1) {
+                    const auto voxel = std::make_tuple(int32_t(position.x), int32_t(position.y), int32_t(position.z));
+                    PointLight& single = singles.try_emplace(voxel, PointLight{position, 0, glm::vec4(r, g, b, a)}).first->second;
+                    single.visibilityMask |= 1u << face;
+                    continue;
+                }
+                
+                PointLight light{position, 1u << face, glm::vec4(r, g, b, a)};
+                light.size[axisU] = static_cast<float>(u1 - u0 + 1);
+                light.size[axisV] = static_cast<float>(v1 - v0 + 1);
+                merged.push_back(light);
+            }
+        }
+        
+        for (const auto& [voxel, light] : singles)
+            merged.push_back(light);
+        
+        lights = std::move(merged);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../../libs/glm/glm.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace arx {
+
+    struct PointLight {
+        glm::vec3 position;
+        uint32_t visibilityMask;
+        glm::vec4 color;
+        glm::vec4 size{1.0f}; // Voxels covered per axis, a merged light is one face wide rectangle
+    };
+
+    // A chunk's lights live in a slab, live ones first. The rest of the slab is tombstones
+    // (visibilityMask 0, skipped by the shaders) that later adds fill in place
+    struct ChunkLightInfo {
+        uint32_t offset; // Offset in the buffer (in terms of PointLight instances)
+        uint32_t count;
+        uint32_t capacity{0}; // Slab size, 0 until Materials::initialize packs the baked ranges
+    };
+
+    // CPU side of the light buffer layout, shared with the offline baker
+    class LightLayout {
+    public:
+        // Packs the per chunk lists into one array in the order they are uploaded
+        static void pack(const std::unordered_map<uint32_t, std::vector<PointLight>>& chunkLights,
+                         std::unordered_map<uint32_t, ChunkLightInfo>& infos,
+                         std::vector<PointLight>& lights);
+        // Greedily merges coplanar same colored faces of a chunk's lights into rectangles.
+        // Faces left on their own go back to one light per voxel, lights with no faces are dropped
+        static void mergeEmissiveFaces(std::vector<PointLight>& lights);
+    };
+}
@@ -0,0 +1,89 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/occupancyGrid.hpp"
+
+namespace arx {
+
+    namespace {
+        // Branch free loops over contiguous words, left for the compiler to vectorize on either target architecture
+        void faceRow(const uint64_t* row, const uint64_t* posY, const uint64_t* negY, const uint64_t* posZ, const uint64_t* negZ,
+                     uint64_t* __restrict faceNegX, uint64_t* __restrict facePosX,
+                     uint64_t* __restrict facePosY, uint64_t* __restrict faceNegY,
+                     uint64_t* __restrict facePosZ, uint64_t* __restrict faceNegZ, uint32_t count) {
+            for (uint32_t w = 0; w < count; ++w) {
+                const uint64_t solid = row[w];
+                // The run shifted by one voxel along X, edge bits are carried in from the adjacent words below
+                faceNegX[w] = solid & ~(solid << 1);
+                facePosX[w] = solid & ~(solid >> 1);
+                facePosY[w] = solid & ~posY[w];
+                faceNegY[w] = solid & ~negY[w];
+                facePosZ[w] = solid & ~posZ[w];
+                faceNegZ[w] = solid & ~negZ[w];
+            }
+            for (uint32_t w = 1; w < count; ++w)
+                faceNegX[w] &= ~(row[w - 1] >> 63);
+            for (uint32_t w = 0; w + 1 < count; ++w)
+                facePosX[w] &= ~(row[w + 1] << 63);
+        }
+    }
+
+    void OccupancyGrid::resize(const glm::uvec3& newSize) {
+        size = newSize;
+        wordsPerRow = (size.x + 63) / 64;
+        words.assign(static_cast<size_t>(wordsPerRow) * size.y * size.z, 0ull);
+        for (std::vector<uint64_t>& face : faceWords)
+            face.assign(words.size(), 0ull);
+        airRow.assign(wordsPerRow, 0ull);
+    }
+
+    void OccupancyGrid::packRow(uint32_t y, uint32_t z, const uint8_t* colorIndices) {
+        uint64_t* row = &words[rowOffset(y, z)];
+        for (uint32_t w = 0; w < wordsPerRow; ++w) {
+            const uint32_t first = w * 64;
+            const uint32_t count = std::min(64u, size.x - first);
+            uint64_t bits = 0;
+            for (uint32_t i = 0; i < count; ++i)
+                bits |= static_cast<uint64_t>(colorIndices[first + i] != 0) << i;
+            row[w] = bits;
+        }
+    }
+
+    void OccupancyGrid::computeFaceRow(uint32_t y, uint32_t z) {
+        const size_t offset = rowOffset(y, z);
+        const uint64_t* posY = y + 1 < size.y ? &words[rowOffset(y + 1, z)] : airRow.data();
+        const uint64_t* negY = y > 0          ? &words[rowOffset(y - 1, z)] : airRow.data();
+        const uint64_t* posZ = z + 1 < size.z ? &words[rowOffset(y, z + 1)] : airRow.data();
+        const uint64_t* negZ = z > 0          ? &words[rowOffset(y, z - 1)] : airRow.data();
+        
+        faceRow(&words[offset], posY, negY, posZ, negZ,
+                &faceWords[FACE_NEG_X][offset], &faceWords[FACE_POS_X][offset],
+                &faceWords[FACE_POS_Y][offset], &faceWords[FACE_NEG_Y][offset],
+                &faceWords[FACE_POS_Z][offset], &faceWords[FACE_NEG_Z][offset], wordsPerRow);
+    }
+
+    void WorldOccupancy::set(const glm::ivec3& cell) {
+        const glm::ivec3 brick = brickOf(cell);
+        const glm::ivec3 local = cell - brick * BRICK_SIZE;
+        
+        auto [it, inserted] = bricks.try_emplace(brick);
+        if (inserted) it->second.fill(0ull);
+        it->second[local.z] |= 1ull << (local.y * BRICK_SIZE + local.x);
+    }
+
+    bool WorldOccupancy::isSolid(const glm::ivec3& cell) const {
+        const glm::ivec3 brick = brickOf(cell);
+        auto it = bricks.find(brick);
+        if (it == bricks.end()) return false;
+        
+        const glm::ivec3 local = cell - brick * BRICK_SIZE;
+        return (it->second[local.z] >> (local.y * BRICK_SIZE + local.x)) & 1ull;
+    }
+
+    uint32_t WorldOccupancy::exposedFaces(const glm::ivec3& cell, uint32_t mask, int stride) const {
+        for (uint32_t i = 0; i < FACE_COUNT; ++i) {
+            if ((mask & (1u << i)) && isSolid(cell + faceDirections()[i] * stride))
+                mask &= ~(1u << i);
+        }
+        return mask;
+    }
+}
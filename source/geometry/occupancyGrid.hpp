@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../../libs/glm/glm.hpp"
+#include "../../libs/glm/gtx/hash.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace arx {
+
+    // Face order matches the InstanceData visibilityMask bits
+    enum VoxelFace : uint32_t {
+        FACE_NEG_X = 0,
+        FACE_POS_X,
+        FACE_POS_Y,
+        FACE_NEG_Y,
+        FACE_POS_Z,
+        FACE_NEG_Z,
+        FACE_COUNT
+    };
+
+    inline const std::array<glm::ivec3, FACE_COUNT>& faceDirections() {
+        static const std::array<glm::ivec3, FACE_COUNT> directions = {
+            glm::ivec3(-1,  0,  0), // Left (negative X)
+            glm::ivec3( 1,  0,  0), // Right (positive X)
+            glm::ivec3( 0,  1,  0), // Bottom (positive Y)
+            glm::ivec3( 0, -1,  0), // Top (negative Y)
+            glm::ivec3( 0,  0,  1), // Back (positive Z)
+            glm::ivec3( 0,  0, -1)  // Front (negative Z)
+        };
+        return directions;
+    }
+
+    // One bit per voxel, packed in 64 voxel runs along X.
+    // Row (y, z) starts at word (z * size.y + y) * wordsPerRow
+    class OccupancyGrid {
+    public:
+        OccupancyGrid() = default;
+        explicit OccupancyGrid(const glm::uvec3& size) { resize(size); }
+        
+        // Clears every voxel to air
+        void resize(const glm::uvec3& size);
+        
+        // Packs a row of size.x palette indices, non zero indices are solid
+        void packRow(uint32_t y, uint32_t z, const uint8_t* colorIndices);
+        
+        void set(uint32_t x, uint32_t y, uint32_t z)            { words[rowOffset(y, z) + (x >> 6)] |=  (1ull << (x & 63)); }
+        void clear(uint32_t x, uint32_t y, uint32_t z)          { words[rowOffset(y, z) + (x >> 6)] &= ~(1ull << (x & 63)); }
+        bool isSolid(uint32_t x, uint32_t y, uint32_t z) const  { return (words[rowOffset(y, z) + (x >> 6)] >> (x & 63)) & 1ull; }
+        
+        // Face words of row (y, z), bit set for every solid voxel whose neighbour across the face is air or outside the grid.
+        // Each word's faces are computed once for the whole grid, rows only read packed rows so they can go on any thread
+        void computeFaceRow(uint32_t y, uint32_t z);
+        
+        // Gathers the six face bits of voxel (x, y, z) into a visibilityMask, after computeFaceRow
+        uint32_t visibilityMask(uint32_t x, uint32_t y, uint32_t z) const {
+            const size_t index = rowOffset(y, z) + (x >> 6);
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < FACE_COUNT; ++i)
+                mask |= static_cast<uint32_t>((faceWords[i][index] >> (x & 63)) & 1ull) << i;
+            return mask;
+        }
+        
+        const glm::uvec3& getSize() const   { return size; }
+        uint32_t getWordsPerRow() const     { return wordsPerRow; }
+        size_t getMemoryUsage() const       { return words.size() * sizeof(uint64_t) * (FACE_COUNT + 1); }
+        
+    private:
+        size_t rowOffset(uint32_t y, uint32_t z) const { return (static_cast<size_t>(z) * size.y + y) * wordsPerRow; }
+        
+        glm::uvec3                                          size{0};
+        uint32_t                                            wordsPerRow{0};
+        std::vector<uint64_t>                               words;
+        std::array<std::vector<uint64_t>, FACE_COUNT>       faceWords; // Laid out like words, one array per face
+        std::vector<uint64_t>                               airRow; // Neighbour row outside the grid
+    };
+
+    // Sparse world space occupancy over all instances of a scene, in 8x8x8 bricks of one bit per voxel.
+    // Faces are in world axes, which is how gbuffer.vert emits them
+    class WorldOccupancy {
+    public:
+        static constexpr int BRICK_SHIFT = 3;
+        static constexpr int BRICK_SIZE = 1 << BRICK_SHIFT;
+        
+        // Voxel translations are integer or all share the same half offset, rounding maps both to cells
+        static glm::ivec3 toCell(const glm::vec3& position) { return glm::ivec3(glm::floor(position + 0.5f)); }
+        
+        void set(const glm::ivec3& cell);
+        bool isSolid(const glm::ivec3& cell) const;
+        
+        // Clears the face bits of mask whose neighbour stride cells away is solid, other bits pass through.
+        // A stride above 1 compares LOD voxels that are only set at their lowest cell
+        uint32_t exposedFaces(const glm::ivec3& cell, uint32_t mask, int stride = 1) const;
+        
+        size_t getBrickCount() const { return bricks.size(); }
+        
+    private:
+        // Word z of a brick holds its 8x8 slice, bit y * 8 + x
+        using Brick = std::array<uint64_t, BRICK_SIZE>;
+        
+        // Arithmetic shift floors negative cells too
+        static glm::ivec3 brickOf(const glm::ivec3& cell) { return glm::ivec3(cell.x >> BRICK_SHIFT, cell.y >> BRICK_SHIFT, cell.z >> BRICK_SHIFT); }
+        
+        std::unordered_map<glm::ivec3, Brick>   bricks;
+    };
+}
@@ -0,0 +1,218 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/sceneCache.hpp"
+
+#include <filesystem>
+
+namespace arx {
+
+    static_assert(sizeof(SceneCache::Header) <= SceneCache::SECTION_ALIGNMENT, "The header has to fit in the first page");
+
+    std::string SceneCache::cachePathFor(const std::string& sourcePath) {
+        return std::filesystem::path(sourcePath).replace_extension(".arxscene").string();
+    }
+
+    bool SceneCache::stampFile(const std::string& filepath, SourceStamp& stamp) {
+        std::error_code error;
+        stamp.size = std::filesystem::file_size(filepath, error);
+        if (error) return false;
+        
+        const auto writeTime = std::filesystem::last_write_time(filepath, error);
+        if (error) return false;
+        stamp.writeTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+        
+        return true;
+    }
+
+    bool SceneCache::hashFile(const std::string& filepath, uint64_t& hash, uint64_t& size) {
+        ArxMappedFile source;
+        if (!source.open(filepath, ArxMappedFile::Access::Sequential)) return false;
+        
+        const uint8_t* data = source.data();
+        size = source.size();
+        
+        // FNV-1a over 64 bit words with a final avalanche, the tail is folded in byte by byte
+        constexpr uint64_t prime = 0x100000001b3ull;
+        hash = 0xcbf29ce484222325ull ^ size;
+        
+        uint64_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(uint64_t));
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ data[i]) * prime;
+        }
+        
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        
+        return true;
+    }
+
+    bool SceneCache::write(const std::string& cachePath, const BakedSceneView& scene, const SourceStamp& source) {
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version      = VERSION;
+        header.headerSize   = sizeof(Header);
+        header.sourceHash       = source.hash;
+        header.sourceSize       = source.size;
+        header.sourceWriteTime  = source.writeTime;
+        header.worldSize    = scene.worldSize;
+        header.areaLights   = scene.areaLights;
+        
+        const std::array<std::pair<const void*, SectionEntry>, SECTION_COUNT> payloads = {{
+            { scene.chunks.data(),       { 0, scene.chunks.size(),       sizeof(BakedChunk),       0 } },
+            { scene.instances.data(),    { 0, scene.instances.size(),    sizeof(PackedInstance),   0 } },
+            { scene.lightRanges.data(),  { 0, scene.lightRanges.size(),  sizeof(BakedLightRange),  0 } },
+            { scene.lights.data(),       { 0, scene.lights.size(),       sizeof(PointLight),       0 } },
+            { scene.palette.data(),      { 0, scene.palette.size(),      sizeof(glm::vec4),        0 } },
+            { scene.meshVertices.data(), { 0, scene.meshVertices.size(), sizeof(uint32_t),         0 } },
+            { scene.meshIndices.data(),  { 0, scene.meshIndices.size(),  sizeof(uint32_t),         0 } },
+            { scene.lodInstances.data(), { 0, scene.lodInstances.size(), sizeof(PackedInstance),   0 } }
+        }};
+        
+        uint64_t offset = SECTION_ALIGNMENT;
+        for (uint32_t i = 0; i < SECTION_COUNT; ++i) {
+            header.sections[i] = payloads[i].second;
+            header.sections[i].offset = offset;
+            const uint64_t bytes = header.sections[i].count * header.sections[i].stride;
+            offset += (bytes + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+        }
+        
+        // Write next to the destination and rename, a crash mid write never leaves a valid looking cache
+        const std::string tempPath = cachePath + ".tmp";
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            ARX_LOG_WARNING("Could not create scene cache {}", tempPath);
+            return false;
+        }
+        
+        const std::vector<char> zeros(SECTION_ALIGNMENT, 0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(zeros.data(), SECTION_ALIGNMENT - sizeof(Header));
+        
+        for (uint32_t i = 0; i < SECTION_COUNT; ++i) {
+            const uint64_t bytes = header.sections[i].count * header.sections[i].stride;
+            out.write(static_cast<const char*>(payloads[i].first), static_cast<std::streamsize>(bytes));
+            const uint64_t pad = ((bytes + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1)) - bytes;
+            out.write(zeros.data(), static_cast<std::streamsize>(pad));
+        }
+        out.close();
+        
+        if (!out) {
+            ARX_LOG_WARNING("Failed writing scene cache {}", tempPath);
+            std::filesystem::remove(tempPath);
+            return false;
+        }
+        
+        std::error_code error;
+        std::filesystem::rename(tempPath, cachePath, error);
+        if (error) {
+            ARX_LOG_WARNING("Failed to move scene cache into place {}: {}", cachePath, error.message());
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        
+        return true;
+    }
+
+    template<typename T>
+    bool SceneCache::section(const Header& header, Section index, std::span<const T>& out) const {
+        const SectionEntry& entry = header.sections[index];
+        if (entry.stride != sizeof(T) ||
+            entry.offset % SECTION_ALIGNMENT != 0 ||
+            entry.offset > file.size() ||
+            entry.count > (file.size() - entry.offset) / sizeof(T)) {
+            return false;
+        }
+        
+        out = std::span<const T>(reinterpret_cast<const T*>(file.data() + entry.offset), entry.count);
+        return true;
+    }
+
+    bool SceneCache::restamp(const std::string& cachePath, const SourceStamp& source) {
+        std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+        if (!out) return false;
+        
+        out.seekp(offsetof(Header, sourceWriteTime));
+        out.write(reinterpret_cast<const char*>(&source.writeTime), sizeof(source.writeTime));
+        return static_cast<bool>(out);
+    }
+
+    bool SceneCache::open(const std::string& cachePath) {
+        close();
+        
+        if (!std::filesystem::exists(cachePath)) return false;
+        if (!file.open(cachePath, ArxMappedFile::Access::Sequential)) return false;
+        
+        if (file.size() < SECTION_ALIGNMENT) {
+            ARX_LOG_WARNING("Scene cache {} is truncated", cachePath);
+            close();
+            return false;
+        }
+        
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+        
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.version != VERSION ||
+            header.headerSize != sizeof(Header)) {
+            ARX_LOG_INFO("Scene cache {} is from another version, rebaking", cachePath);
+            close();
+            return false;
+        }
+        
+        source = SourceStamp{header.sourceSize, header.sourceWriteTime, header.sourceHash};
+        
+        view = BakedSceneView{};
+        view.worldSize  = header.worldSize;
+        view.areaLights = header.areaLights;
+        
+        if (!section(header, SECTION_CHUNKS, view.chunks) ||
+            !section(header, SECTION_INSTANCES, view.instances) ||
+            !section(header, SECTION_LIGHT_RANGES, view.lightRanges) ||
+            !section(header, SECTION_LIGHTS, view.lights) ||
+            !section(header, SECTION_PALETTE, view.palette) ||
+            view.palette.size() != PackedInstance::PALETTE_SIZE ||
+            !section(header, SECTION_MESH_VERTICES, view.meshVertices) ||
+            !section(header, SECTION_MESH_INDICES, view.meshIndices) ||
+            !section(header, SECTION_LOD_INSTANCES, view.lodInstances)) {
+            ARX_LOG_WARNING("Scene cache {} has a malformed section table", cachePath);
+            close();
+            return false;
+        }
+        
+        for (const BakedChunk& chunk : view.chunks) {
+            if (uint64_t(chunk.instanceOffset) + chunk.instanceCount > view.instances.size() ||
+                uint64_t(chunk.lodOffset) + chunk.lodCounts[0] + chunk.lodCounts[1] > view.lodInstances.size()) {
+                ARX_LOG_WARNING("Scene cache {} has a chunk outside of the instance section", cachePath);
+                close();
+                return false;
+            }
+            if (chunk.vertexOffset < 0 ||
+                uint64_t(chunk.vertexOffset) + chunk.vertexCount > view.meshVertices.size() ||
+                uint64_t(chunk.firstIndex) + chunk.indexCount > view.meshIndices.size()) {
+                ARX_LOG_WARNING("Scene cache {} has a chunk mesh outside of the mesh sections", cachePath);
+                close();
+                return false;
+            }
+        }
+        for (const BakedLightRange& range : view.lightRanges) {
+            if (uint64_t(range.offset) + range.count > view.lights.size()) {
+                ARX_LOG_WARNING("Scene cache {} has a light range outside of the light section", cachePath);
+                close();
+                return false;
+            }
+        }
+        
+        return true;
+    }
+
+    void SceneCache::close() {
+        view = BakedSceneView{};
+        file.close();
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "../../source/geometry/voxelTypes.hpp"
+#include "../../source/geometry/lightLayout.hpp"
+#include "../../source/arx_mapped_file.h"
+
+#include <span>
+
+namespace arx {
+
+    // A chunk of the baked scene, its instances are instances[instanceOffset, instanceOffset + instanceCount)
+    // and its downsampled LODs lodInstances[lodOffset, lodOffset + lodCounts[0] + lodCounts[1]), 2x before 4x
+    struct BakedChunk {
+        glm::vec3 position;
+        uint32_t instanceOffset;
+        glm::vec3 aabbMin;
+        uint32_t instanceCount;
+        glm::vec3 aabbMax;
+        uint32_t padding;
+        glm::vec4 origin; // xyz origin the instances are packed against, w voxel step
+        uint32_t firstIndex; // Greedy mesh, meshIndices[firstIndex, firstIndex + indexCount) over
+        uint32_t indexCount; // meshVertices[vertexOffset, vertexOffset + vertexCount)
+        int32_t vertexOffset;
+        uint32_t vertexCount;
+        uint32_t lodOffset;
+        uint32_t lodCounts[PackedInstance::LOD_COUNT - 1];
+        uint32_t lodPadding;
+    };
+
+    // Materials::chunkLightInfos entry
+    struct BakedLightRange {
+        uint32_t chunkID;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // Everything vox2Chunks produces before touching the GPU
+    struct BakedScene {
+        glm::vec3                       worldSize{0.0f};
+        uint32_t                        areaLights{0};
+        std::vector<BakedChunk>         chunks;
+        std::vector<PackedInstance>     instances;
+        std::vector<PackedInstance>     lodInstances;
+        std::vector<BakedLightRange>    lightRanges;
+        std::vector<PointLight>         lights;
+        std::vector<glm::vec4>          palette;
+        std::vector<uint32_t>           meshVertices;
+        std::vector<uint32_t>           meshIndices;
+    };
+
+    // Non owning view of a baked scene, either over a BakedScene or straight over a mapped .arxscene
+    struct BakedSceneView {
+        glm::vec3                           worldSize{0.0f};
+        uint32_t                            areaLights{0};
+        std::span<const BakedChunk>         chunks;
+        std::span<const PackedInstance>     instances;
+        std::span<const PackedInstance>     lodInstances;
+        std::span<const BakedLightRange>    lightRanges;
+        std::span<const PointLight>         lights;
+        std::span<const glm::vec4>          palette;
+        std::span<const uint32_t>           meshVertices;
+        std::span<const uint32_t>           meshIndices;
+        
+        BakedSceneView() = default;
+        BakedSceneView(const BakedScene& scene)
+        : worldSize{scene.worldSize}, areaLights{scene.areaLights}, chunks{scene.chunks}, instances{scene.instances},
+          lodInstances{scene.lodInstances}, lightRanges{scene.lightRanges}, lights{scene.lights}, palette{scene.palette},
+          meshVertices{scene.meshVertices}, meshIndices{scene.meshIndices} {}
+        
+        std::span<const PackedInstance> chunkInstances(const BakedChunk& chunk) const {
+            return instances.subspan(chunk.instanceOffset, chunk.instanceCount);
+        }
+        
+        std::span<const PackedInstance> chunkLodInstances(const BakedChunk& chunk) const {
+            return lodInstances.subspan(chunk.lodOffset, chunk.lodCounts[0] + chunk.lodCounts[1]);
+        }
+    };
+
+    // Identifies the .vox a cache was baked from
+    struct SourceStamp {
+        uint64_t size{0};
+        int64_t  writeTime{0};  // Filesystem clock ticks
+        uint64_t hash{0};       // See SceneCache::hashFile
+    };
+
+    // .arxscene files: a header page followed by page aligned sections that are used in place once mapped
+    class SceneCache {
+    public:
+        static constexpr char       MAGIC[8] = {'A', 'R', 'X', 'S', 'C', 'E', 'N', 'E'};
+        // Bump whenever the baking or any of the section structs change
+        static constexpr uint32_t   VERSION = 7;
+        static constexpr uint64_t   SECTION_ALIGNMENT = 4096;
+        
+        enum Section : uint32_t {
+            SECTION_CHUNKS = 0,
+            SECTION_INSTANCES,
+            SECTION_LIGHT_RANGES,
+            SECTION_LIGHTS,
+            SECTION_PALETTE,
+            SECTION_MESH_VERTICES,
+            SECTION_MESH_INDICES,
+            SECTION_LOD_INSTANCES,
+            SECTION_COUNT
+        };
+        
+        struct SectionEntry {
+            uint64_t offset;
+            uint64_t count;
+            uint32_t stride;
+            uint32_t padding;
+        };
+        
+        struct Header {
+            char            magic[8];
+            uint32_t        version;
+            uint32_t        headerSize;
+            uint64_t        sourceHash;
+            uint64_t        sourceSize;
+            int64_t         sourceWriteTime;
+            glm::vec3       worldSize;
+            uint32_t        areaLights;
+            SectionEntry    sections[SECTION_COUNT];
+        };
+        
+        // data/scenes/name.vox -> data/scenes/name.arxscene
+        static std::string cachePathFor(const std::string& sourcePath);
+        
+        // Size and write time, what a warm start checks before trusting the cache
+        static bool stampFile(const std::string& filepath, SourceStamp& stamp);
+        // 64 bit hash of the whole file contents, only needed when the stamp differs or when baking
+        static bool hashFile(const std::string& filepath, uint64_t& hash, uint64_t& size);
+        
+        static bool write(const std::string& cachePath, const BakedSceneView& scene, const SourceStamp& source);
+        // Updates the source write time in the header in place, for a source whose contents didn't change
+        static bool restamp(const std::string& cachePath, const SourceStamp& source);
+        
+        // Maps the cache, fails if it is missing or was written by another version. Whether it is
+        // still up to date with its source is up to the caller, see getSource
+        bool open(const std::string& cachePath);
+        void close();
+        
+        bool isOpen() const { return file.isOpen(); }
+        const BakedSceneView& getView() const { return view; }
+        // Stamp of the .vox the open cache was baked from
+        const SourceStamp& getSource() const { return source; }
+        
+    private:
+        template<typename T>
+        bool section(const Header& header, Section index, std::span<const T>& out) const;
+        
+        ArxMappedFile       file;
+        BakedSceneView      view;
+        SourceStamp         source;
+    };
+}
@@ -5,9 +5,9 @@
 namespace arx {
 
     SVONode::SVONode(const glm::vec3& min, const glm::vec3& max)
-    : min(min), max(max), chunkData(nullptr), childrenStartIndex(0), voxelStartIndex(0) {}
+    : min(min), max(max), childrenStartIndex(0), voxelStartIndex(0), chunkData(nullptr) {}
 
-    void SVONode::split(size_t& nextNodeIndex) {
+    void SVONode::split(size_t& /*nextNodeIndex*/) {
         if (!isLeaf()) return;
 
         glm::vec3 center = (min + max) * 0.5f;
@@ -42,7 +42,7 @@ namespace arx {
     }
 
     SVONode* SVONode::getChild(int index) {
-        if (index < 0 || index >= children.size()) return nullptr;
+        if (index < 0 || index >= static_cast<int>(children.size())) return nullptr;
         return children[index].get();
     }
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../source/managers/arx_buffer_manager.hpp"
+#include "../source/geometry/voxelTypes.hpp"
 
 namespace arx {
 
@@ -0,0 +1,403 @@
+#include "../source/engine_pch.hpp"
+
+#define OGT_VOX_IMPLEMENTATION
+#include "../source/geometry/voxBaker.hpp"
+#include "../source/geometry/svo.hpp"
+#include "../source/geometry/greedyMesher.hpp"
+#include "../source/geometry/chunkLod.hpp"
+#include "../source/arx_mapped_file.h"
+
+namespace arx {
+
+    namespace {
+        // Runs fn(first, stride) on up to every pool thread and waits, inline when there is nothing to split
+        template<typename Fn>
+        void parallelFor(ThreadPool& threadPool, uint32_t count, Fn&& fn) {
+            const uint32_t workerCount = static_cast<uint32_t>(threadPool.threads.size());
+            if (workerCount > 1 && count > 1) {
+                const uint32_t jobCount = std::min(workerCount, count);
+                for (uint32_t i = 0; i < jobCount; ++i) {
+                    threadPool.threads[i]->addJob([&fn, i, jobCount]() {
+                        fn(i, jobCount);
+                    });
+                }
+                threadPool.wait();
+            } else {
+                fn(0, 1);
+            }
+        }
+        
+        // Local face i of a rotated instance ends up on world face remap[i]
+        std::array<uint32_t, FACE_COUNT> faceRemap(const glm::mat4& modelTransform) {
+            std::array<uint32_t, FACE_COUNT> remap;
+            for (uint32_t i = 0; i < FACE_COUNT; ++i) {
+                glm::ivec3 world = glm::ivec3(glm::round(glm::mat3(modelTransform) * glm::vec3(faceDirections()[i])));
+                auto it = std::find(faceDirections().begin(), faceDirections().end(), world);
+                remap[i] = it != faceDirections().end() ? static_cast<uint32_t>(it - faceDirections().begin()) : i;
+            }
+            return remap;
+        }
+    }
+    
+    const ogt_vox_scene* VoxBaker::loadVoxModel(const std::string& filepath) {
+        // The parser reads straight out of the page cache, no intermediate heap copy
+        ArxMappedFile file;
+        if (!file.open(filepath, ArxMappedFile::Access::Sequential)) {
+            ARX_LOG_ERROR("Failed to open the .vox file {}", filepath);
+            return nullptr;
+        }
+        
+        // .vox chunk sizes are 32 bit and so is the parser's buffer size
+        if (file.size() > std::numeric_limits<uint32_t>::max()) {
+            ARX_LOG_ERROR("{} is {} bytes, .vox files are limited to 4GB", filepath, file.size());
+            return nullptr;
+        }
+
+        // Load the scene, it owns copies of everything it needs so the mapping can go right after
+        const ogt_vox_scene* scene = ogt_vox_read_scene(file.data(), static_cast<uint32_t>(file.size()));
+
+        if (!scene) {
+            ARX_LOG_ERROR("Failed to read .vox scene: {}", filepath);
+        }
+
+        return scene;
+    }
+
+    glm::mat4 VoxBaker::ogtTransformToMat4(const ogt_vox_transform& transform) {
+        return glm::mat4(
+            transform.m00, transform.m01, transform.m02, transform.m03,
+            transform.m10, transform.m11, transform.m12, transform.m13,
+            transform.m20, transform.m21, transform.m22, transform.m23,
+            transform.m30, transform.m31, transform.m32, transform.m33
+        );
+    }
+
+    bool VoxBaker::bake(const std::string& filepath, ThreadPool& threadPool, BakedScene& baked, std::unique_ptr<SVO>& svo, BakeStats& stats) {
+        stats = BakeStats{};
+        
+        Timer::start();
+        const ogt_vox_scene* scene = loadVoxModel(filepath);
+        if (!scene) return false;
+        stats.loadTime = Timer::stop();
+        
+        glm::mat4 worldPosMatrix = glm::mat4(1.f);
+        
+        // Calculate world size
+        glm::vec3 worldSize(0.0f);
+        for (uint32_t instanceIndex = 0; instanceIndex < scene->num_instances; ++instanceIndex) {
+            const ogt_vox_instance* instance = &scene->instances[instanceIndex];
+            const ogt_vox_model* model = scene->models[instance->model_index];
+            glm::mat4 modelTransform = ogtTransformToMat4(instance->transform);
+            glm::vec3 maxBounds(model->size_x, model->size_y, model->size_z);
+            glm::vec4 transformedMax = modelTransform * glm::vec4(maxBounds, 1.0f);
+            worldSize = glm::max(worldSize, glm::vec3(transformedMax));
+        }
+        
+        // Create SVO
+        svo = std::make_unique<SVO>(worldSize, CHUNK_SIZE);
+        std::unordered_map<uint32_t, std::vector<PointLight>> chunkLights;
+        
+        baked = BakedScene{};
+        baked.worldSize = worldSize;
+        
+        stats.threadCount = std::max(static_cast<uint32_t>(threadPool.threads.size()), 1u);
+        
+        OccupancyGrid occupancy;
+        std::vector<InstanceData> instances;
+
+        for (uint32_t instanceIndex = 0; instanceIndex < scene->num_instances; ++instanceIndex) {
+            
+            const ogt_vox_instance* instance = &scene->instances[instanceIndex];
+            const ogt_vox_model* model = scene->models[instance->model_index];
+
+            glm::mat4 modelTransform = ogtTransformToMat4(instance->transform);
+            glm::vec3 maxBounds(model->size_x, model->size_y, model->size_z);
+            const std::array<uint32_t, FACE_COUNT> remap = faceRemap(modelTransform);
+
+            int numChunksX = static_cast<int>(std::ceil(maxBounds.x / CHUNK_SIZE));
+            int numChunksY = static_cast<int>(std::ceil(maxBounds.y / CHUNK_SIZE));
+            int numChunksZ = static_cast<int>(std::ceil(maxBounds.z / CHUNK_SIZE));
+            
+            Timer::start();
+            // First pass: pack the model into the occupancy bit grid, voxel_data rows already run along X
+            occupancy.resize(glm::uvec3(model->size_x, model->size_y, model->size_z));
+            for (uint32_t voxelZ = 0; voxelZ < model->size_z; ++voxelZ) {
+                for (uint32_t voxelY = 0; voxelY < model->size_y; ++voxelY) {
+                    occupancy.packRow(voxelY, voxelZ, &model->voxel_data[(voxelY * model->size_x) + (voxelZ * model->size_x * model->size_y)]);
+                }
+            }
+            
+            // Faces of every row word once, the tiles below only slice them
+            parallelFor(threadPool, model->size_z, [&](uint32_t first, uint32_t stride) {
+                for (uint32_t voxelZ = first; voxelZ < model->size_z; voxelZ += stride) {
+                    for (uint32_t voxelY = 0; voxelY < model->size_y; ++voxelY)
+                        occupancy.computeFaceRow(voxelY, voxelZ);
+                }
+            });
+            stats.occupancyTime += Timer::stop();
+            stats.voxels += static_cast<uint64_t>(model->size_x) * model->size_y * model->size_z;
+
+            // Second pass: every chunk sized tile is built independently on the thread pool.
+            // Tiles are indexed in x, y, z order so the merge below matches the serial path
+            Timer::start();
+            const uint32_t tileCount = static_cast<uint32_t>(numChunksX * numChunksY * numChunksZ);
+            std::vector<ChunkTile> tiles(tileCount);
+            
+            auto buildTiles = [&](uint32_t first, uint32_t stride) {
+                for (uint32_t tileIndex = first; tileIndex < tileCount; tileIndex += stride) {
+                    int chunkZ = tileIndex % numChunksZ;
+                    int chunkY = (tileIndex / numChunksZ) % numChunksY;
+                    int chunkX = tileIndex / (numChunksZ * numChunksY);
+                    buildChunkTile(scene, model, occupancy, modelTransform, remap, glm::ivec3(chunkX, chunkY, chunkZ), tiles[tileIndex]);
+                }
+            };
+            
+            parallelFor(threadPool, tileCount, buildTiles);
+            stats.tileTime += Timer::stop();
+
+            // Merge on the calling thread in tile order
+            Timer::start();
+            for (uint32_t tileIndex = 0; tileIndex < tileCount; ++tileIndex) {
+                ChunkTile& tile = tiles[tileIndex];
+                
+                for (const auto& [chunkID, light] : tile.lights)
+                    chunkLights[chunkID].push_back(light);
+                
+                if (tile.instances.empty()) continue;
+                
+                int z = tileIndex % numChunksZ;
+                int y = (tileIndex / numChunksZ) % numChunksY;
+                int x = tileIndex / (numChunksZ * numChunksY);
+                glm::vec3 chunkPosition = glm::vec3(worldPosMatrix * modelTransform * glm::vec4(x * CHUNK_SIZE, y * CHUNK_SIZE, z * CHUNK_SIZE, 1.0f));
+                
+                BakedChunk chunk{};
+                chunk.position       = chunkPosition;
+                chunk.instanceOffset = static_cast<uint32_t>(instances.size());
+                chunk.instanceCount  = static_cast<uint32_t>(tile.instances.size());
+                chunk.aabbMin        = chunkPosition;
+                chunk.aabbMax        = chunkPosition + glm::vec3(CHUNK_SIZE);
+                baked.chunks.push_back(chunk);
+                instances.insert(instances.end(), tile.instances.begin(), tile.instances.end());
+            }
+            stats.mergeTime += Timer::stop();
+        }
+        
+        baked.palette.resize(PackedInstance::PALETTE_SIZE);
+        for (uint32_t i = 0; i < PackedInstance::PALETTE_SIZE; ++i) {
+            baked.palette[i] = glm::vec4(scene->palette.color[i].r / 255.0f,
+                                         scene->palette.color[i].g / 255.0f,
+                                         scene->palette.color[i].b / 255.0f,
+                                         /*scene->materials.matl[i].spec*/0.5f);
+        }
+        
+        ogt_vox_destroy_scene(scene);
+        
+        // Third pass: faces are only hidden by voxels of their own model so far. Recheck the faces that are
+        // still visible against every instance in world space, where models touch or overlap
+        Timer::start();
+        WorldOccupancy worldOccupancy;
+        for (const InstanceData& instance : instances)
+            worldOccupancy.set(WorldOccupancy::toCell(glm::vec3(instance.translation)));
+        
+        std::vector<uint64_t> hiddenPerChunk(baked.chunks.size(), 0);
+        parallelFor(threadPool, static_cast<uint32_t>(baked.chunks.size()), [&](uint32_t first, uint32_t stride) {
+            for (uint32_t chunkIndex = first; chunkIndex < baked.chunks.size(); chunkIndex += stride) {
+                const BakedChunk& chunk = baked.chunks[chunkIndex];
+                for (uint32_t i = chunk.instanceOffset; i < chunk.instanceOffset + chunk.instanceCount; ++i) {
+                    InstanceData& instance = instances[i];
+                    const uint32_t mask = worldOccupancy.exposedFaces(WorldOccupancy::toCell(glm::vec3(instance.translation)), instance.visibilityMask);
+                    hiddenPerChunk[chunkIndex] += std::popcount(instance.visibilityMask ^ mask);
+                    instance.visibilityMask = mask;
+                }
+            }
+        });
+        stats.hiddenFaces = std::accumulate(hiddenPerChunk.begin(), hiddenPerChunk.end(), uint64_t(0));
+        
+        // Emissive faces follow their voxel, then the faces of a chunk merge into as few lights as they can
+        const uint64_t emissiveVoxels = std::accumulate(chunkLights.begin(), chunkLights.end(), uint64_t(0),
+                                                        [](uint64_t sum, const auto& chunk) { return sum + chunk.second.size(); });
+        for (auto& [chunkID, lights] : chunkLights) {
+            for (PointLight& light : lights)
+                light.visibilityMask = worldOccupancy.exposedFaces(WorldOccupancy::toCell(light.position), light.visibilityMask);
+            
+            LightLayout::mergeEmissiveFaces(lights);
+            for (const PointLight& light : lights)
+                baked.areaLights += std::popcount(light.visibilityMask | (1u << 6));
+        }
+        std::erase_if(chunkLights, [](const auto& chunk) { return chunk.second.empty(); });
+        ARX_LOG_INFO("Merged {} emissive voxels into {} lights", emissiveVoxels,
+                     std::accumulate(chunkLights.begin(), chunkLights.end(), uint64_t(0),
+                                     [](uint64_t sum, const auto& chunk) { return sum + chunk.second.size(); }));
+        stats.faceTime = Timer::stop();
+        
+        Timer::start();
+        for (const BakedChunk& chunk : baked.chunks) {
+            svo->insertChunk(chunk.position, std::vector<InstanceData>(instances.begin() + chunk.instanceOffset,
+                                                                       instances.begin() + chunk.instanceOffset + chunk.instanceCount));
+        }
+        
+        // Pack every chunk against its lowest voxel so rotated instances still land in [0, CHUNK_SIZE) per axis
+        baked.instances.resize(instances.size());
+        parallelFor(threadPool, static_cast<uint32_t>(baked.chunks.size()), [&](uint32_t first, uint32_t stride) {
+            for (uint32_t chunkIndex = first; chunkIndex < baked.chunks.size(); chunkIndex += stride) {
+                BakedChunk& chunk = baked.chunks[chunkIndex];
+                const uint32_t end = chunk.instanceOffset + chunk.instanceCount;
+                
+                glm::vec3 origin = glm::vec3(instances[chunk.instanceOffset].translation);
+                for (uint32_t i = chunk.instanceOffset; i < end; ++i)
+                    origin = glm::min(origin, glm::vec3(instances[i].translation));
+                
+                chunk.origin = glm::vec4(origin, 1.0f);
+                for (uint32_t i = chunk.instanceOffset; i < end; ++i)
+                    baked.instances[i] = PackedInstance::pack(instances[i], chunkIndex, chunk.origin);
+            }
+        });
+        stats.mergeTime += Timer::stop();
+        
+        // Greedy mesh every chunk for the meshed G-pass, then lay the meshes out back to back in chunk order
+        Timer::start();
+        std::vector<std::pair<std::vector<uint32_t>, std::vector<uint32_t>>> chunkMeshes(baked.chunks.size());
+        parallelFor(threadPool, static_cast<uint32_t>(baked.chunks.size()), [&](uint32_t first, uint32_t stride) {
+            for (uint32_t chunkIndex = first; chunkIndex < baked.chunks.size(); chunkIndex += stride) {
+                const BakedChunk& chunk = baked.chunks[chunkIndex];
+                GreedyMesher::meshChunk(std::span<const PackedInstance>(baked.instances).subspan(chunk.instanceOffset, chunk.instanceCount),
+                                        chunkMeshes[chunkIndex].first, chunkMeshes[chunkIndex].second);
+            }
+        });
+        
+        for (uint32_t chunkIndex = 0; chunkIndex < baked.chunks.size(); ++chunkIndex) {
+            auto& [vertices, indices] = chunkMeshes[chunkIndex];
+            BakedChunk& chunk = baked.chunks[chunkIndex];
+            chunk.firstIndex    = static_cast<uint32_t>(baked.meshIndices.size());
+            chunk.indexCount    = static_cast<uint32_t>(indices.size());
+            chunk.vertexOffset  = static_cast<int32_t>(baked.meshVertices.size());
+            chunk.vertexCount   = static_cast<uint32_t>(vertices.size());
+            baked.meshVertices.insert(baked.meshVertices.end(), vertices.begin(), vertices.end());
+            baked.meshIndices.insert(baked.meshIndices.end(), indices.begin(), indices.end());
+        }
+        
+        for (const PackedInstance& instance : baked.instances)
+            stats.visibleFaces += std::popcount((instance.data >> 12) & 0x3Fu);
+        stats.meshQuads = baked.meshIndices.size() / 6;
+        stats.meshTime = Timer::stop();
+        
+        // Downsample every chunk into its coarser LODs, then cull their faces against the coarse voxels of all chunks.
+        // Those only line up across chunks whose origins share the LOD's alignment, other boundary faces stay visible
+        Timer::start();
+        constexpr uint32_t COARSE_LODS = PackedInstance::LOD_COUNT - 1;
+        std::vector<std::array<std::vector<InstanceData>, COARSE_LODS>> chunkLods(baked.chunks.size());
+        parallelFor(threadPool, static_cast<uint32_t>(baked.chunks.size()), [&](uint32_t first, uint32_t stride) {
+            for (uint32_t chunkIndex = first; chunkIndex < baked.chunks.size(); chunkIndex += stride) {
+                const BakedChunk& chunk = baked.chunks[chunkIndex];
+                const std::span<const InstanceData> chunkInstances(instances.data() + chunk.instanceOffset, chunk.instanceCount);
+                for (uint32_t lod = 1; lod <= COARSE_LODS; ++lod)
+                    ChunkLod::downsample(chunkInstances, chunk.origin, lod, chunkLods[chunkIndex][lod - 1]);
+            }
+        });
+        
+        for (uint32_t lod = 1; lod <= COARSE_LODS; ++lod) {
+            WorldOccupancy lodOccupancy;
+            for (const auto& lods : chunkLods) {
+                for (const InstanceData& voxel : lods[lod - 1])
+                    lodOccupancy.set(WorldOccupancy::toCell(glm::vec3(voxel.translation)));
+            }
+            
+            parallelFor(threadPool, static_cast<uint32_t>(baked.chunks.size()), [&](uint32_t first, uint32_t stride) {
+                for (uint32_t chunkIndex = first; chunkIndex < baked.chunks.size(); chunkIndex += stride) {
+                    std::vector<InstanceData>& voxels = chunkLods[chunkIndex][lod - 1];
+                    for (InstanceData& voxel : voxels)
+                        voxel.visibilityMask = lodOccupancy.exposedFaces(WorldOccupancy::toCell(glm::vec3(voxel.translation)), voxel.visibilityMask, 1 << lod);
+                    // Fully enclosed coarse voxels are never seen, unlike full resolution ones they are not needed for editing
+                    std::erase_if(voxels, [](const InstanceData& voxel) { return (voxel.visibilityMask & 0x3F) == 0; });
+                }
+            });
+        }
+        
+        for (uint32_t chunkIndex = 0; chunkIndex < baked.chunks.size(); ++chunkIndex) {
+            BakedChunk& chunk = baked.chunks[chunkIndex];
+            chunk.lodOffset = static_cast<uint32_t>(baked.lodInstances.size());
+            for (uint32_t lod = 1; lod <= COARSE_LODS; ++lod) {
+                const std::vector<InstanceData>& voxels = chunkLods[chunkIndex][lod - 1];
+                chunk.lodCounts[lod - 1] = static_cast<uint32_t>(voxels.size());
+                stats.lodInstances[lod - 1] += voxels.size();
+                for (const InstanceData& voxel : voxels)
+                    baked.lodInstances.push_back(PackedInstance::pack(voxel, chunkIndex, chunk.origin, lod));
+            }
+        }
+        stats.lodTime = Timer::stop();
+        
+        Timer::start();
+        
+        // Set a dummy light for scenes with no light
+        // My system doesn't support nulldescriptors
+        
+        PointLight light;
+        light.position = glm::vec3(0,0,0);
+        light.color = glm::vec4(1);
+        light.visibilityMask = 0;
+        
+        if (chunkLights.size() == 0) chunkLights[0].push_back(light);
+        
+        std::unordered_map<uint32_t, ChunkLightInfo> lightInfos;
+        LightLayout::pack(chunkLights, lightInfos, baked.lights);
+        for (const auto& [chunkID, cli] : lightInfos)
+            baked.lightRanges.push_back({chunkID, cli.offset, cli.count});
+        
+        stats.mergeTime += Timer::stop();
+        
+        stats.chunks = baked.chunks.size();
+        stats.lights = baked.lights.size();
+
+        return true;
+    }
+
+    void VoxBaker::buildChunkTile(const ogt_vox_scene* scene, const ogt_vox_model* model, const OccupancyGrid& occupancy,
+                                  const glm::mat4& modelTransform, const std::array<uint32_t, FACE_COUNT>& remap,
+                                  const glm::ivec3& chunkCoord, ChunkTile& tile) {
+        const glm::uvec3 begin = glm::uvec3(chunkCoord) * static_cast<uint32_t>(CHUNK_SIZE);
+        const glm::uvec3 end = glm::min(begin + glm::uvec3(CHUNK_SIZE), glm::uvec3(model->size_x, model->size_y, model->size_z));
+        
+        for (uint32_t voxelX = begin.x; voxelX < end.x; ++voxelX) {
+            for (uint32_t voxelY = begin.y; voxelY < end.y; ++voxelY) {
+                for (uint32_t voxelZ = begin.z; voxelZ < end.z; ++voxelZ) {
+                    uint32_t colorIndex = model->voxel_data[voxelX + (voxelY * model->size_x) + (voxelZ * model->size_x * model->size_y)];
+                    if (colorIndex == 0) continue;
+                    
+                    glm::vec4 position(voxelX, voxelY, voxelZ, 1.0f);
+                    glm::vec4 worldPosition = modelTransform * position; // Transform to world space
+                    glm::vec4 color = glm::vec4(scene->palette.color[colorIndex].r / 255.0f,
+                                                scene->palette.color[colorIndex].g / 255.0f,
+                                                scene->palette.color[colorIndex].b / 255.0f,
+                                                /*scene->materials.matl[colorIndex].spec*/0.5f);
+                    
+                    uint32_t localMask = occupancy.visibilityMask(voxelX, voxelY, voxelZ);
+                    
+                    // The cube is drawn in world axes, rotate the face bits with the instance
+                    uint32_t visibilityMask = 0;
+                    for (uint32_t i = 0; i < FACE_COUNT; ++i)
+                        visibilityMask |= ((localMask >> i) & 1u) << remap[i];
+                    
+                    ogt_matl_type mat = scene->materials.matl[colorIndex].type;
+                    if (mat == 3) { // Emit
+                        // Values of 0-1023 for each direction, otherwise I need more than 32bits
+                        uint32_t chunkID = (chunkCoord.x & 0x3FF) | ((chunkCoord.y & 0x3FF) << 10) | ((chunkCoord.z & 0x3FF) << 20);
+                        
+                        PointLight light;
+                        light.position = glm::vec3(worldPosition);
+                        light.color = color;
+                        light.visibilityMask = visibilityMask;
+                        visibilityMask |= (1u << 6);
+                        tile.lights.push_back({chunkID, light});
+                    }
+
+                    InstanceData instance{};
+                    instance.translation    = worldPosition;
+                    instance.color          = color;
+                    instance.visibilityMask = visibilityMask;
+                    instance.paletteIndex   = colorIndex;
+                    tile.instances.push_back(instance);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../../source/geometry/voxelTypes.hpp"
+#include "../../source/geometry/lightLayout.hpp"
+#include "../../source/geometry/occupancyGrid.hpp"
+#include "../../source/geometry/sceneCache.hpp"
+#include "../../source/threadpool.h"
+
+#include "../../libs/ogt_vox.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace arx {
+
+    class SVO;
+
+    // Output of one chunk sized tile of a model, built on a worker and merged on the main thread
+    struct ChunkTile {
+        std::vector<InstanceData>                       instances;
+        std::vector<std::pair<uint32_t, PointLight>>    lights; // chunkID, light
+    };
+
+    // Per phase timings in ms and totals of a .vox bake
+    struct BakeStats {
+        double      loadTime{0.0};
+        double      occupancyTime{0.0};
+        double      tileTime{0.0};
+        double      mergeTime{0.0};
+        double      faceTime{0.0};
+        double      meshTime{0.0};
+        double      lodTime{0.0};
+        uint32_t    threadCount{1};
+        uint64_t    voxels{0}; // Grid cells scanned, air included
+        uint64_t    chunks{0};
+        uint64_t    lights{0};
+        uint64_t    hiddenFaces{0}; // Faces only hidden by a neighbouring instance
+        uint64_t    visibleFaces{0};
+        uint64_t    meshQuads{0}; // Greedy quads covering the visibleFaces
+        uint64_t    lodInstances[PackedInstance::LOD_COUNT - 1]{}; // 2x and 4x voxels with a visible face
+        
+        double totalTime() const { return loadTime + occupancyTime + tileTime + mergeTime + faceTime + meshTime + lodTime; }
+    };
+
+    // .vox to BakedScene, CPU only so arx_bake links it without a window or a device
+    class VoxBaker {
+    public:
+        static bool bake(const std::string& filepath, ThreadPool& threadPool, BakedScene& baked, std::unique_ptr<SVO>& svo, BakeStats& stats);
+        
+    private:
+        static const ogt_vox_scene* loadVoxModel(const std::string& filepath);
+        static glm::mat4 ogtTransformToMat4(const ogt_vox_transform& transform);
+        static void buildChunkTile(const ogt_vox_scene* scene, const ogt_vox_model* model, const OccupancyGrid& occupancy,
+                                   const glm::mat4& modelTransform, const std::array<uint32_t, FACE_COUNT>& remap,
+                                   const glm::ivec3& chunkCoord, ChunkTile& tile);
+    };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../../libs/glm/glm.hpp"
+
+#include <span>
+#include <cassert>
+#include <cstdint>
+
+// Voxel data shared by the renderer and the offline baker, nothing in here may depend on Vulkan
+
+namespace arx {
+
+static const int CHUNK_SIZE = 8;
+static const float VOXEL_SIZE = 0.5;
+static const int ADJUSTED_CHUNK = CHUNK_SIZE / VOXEL_SIZE;
+
+    // SVO Nodes
+    struct GPUNode {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t childrenStartIndex;
+        uint32_t voxelStartIndex;
+    };
+
+    // Per-instance data block, CPU side for the SVO and editing, the GPU gets PackedInstance
+    struct InstanceData {
+        glm::vec4 translation{};
+        glm::vec4 color{};
+        uint32_t visibilityMask{0x3F};
+        uint32_t paletteIndex{0};
+        uint32_t padding[2];
+    };
+
+    // 8 byte instance drawn by the G-pass, decoded in gbuffer.vert with the chunk origin and palette buffers
+    // data: bits 0-11 position in voxel steps from the chunk origin (4 bits per axis), 12-18 visibilityMask, 19-26 palette index,
+    // 27-28 LOD, the voxel is 2^LOD steps wide and positioned at its lowest child
+    struct PackedInstance {
+        uint32_t chunkIndex;
+        uint32_t data;
+        
+        static constexpr uint32_t MAX_LOCAL_POSITION = 15;
+        static constexpr uint32_t PALETTE_SIZE = 256;
+        static constexpr uint32_t LOD_COUNT = 3; // Full resolution, 2x and 4x downsampled
+        
+        // origin: xyz chunk origin, w voxel step
+        static PackedInstance pack(const InstanceData& instance, uint32_t chunkIndex, const glm::vec4& origin, uint32_t lod = 0) {
+            const glm::uvec3 local = glm::uvec3(glm::round((glm::vec3(instance.translation) - glm::vec3(origin)) / origin.w));
+            assert(glm::all(glm::lessThanEqual(local, glm::uvec3(MAX_LOCAL_POSITION))) && "Voxel is outside of its chunk origin range");
+            
+            return {chunkIndex, local.x | (local.y << 4) | (local.z << 8) |
+                                ((instance.visibilityMask & 0x7F) << 12) | ((instance.paletteIndex & 0xFF) << 19) | ((lod & 0x3) << 27)};
+        }
+        
+        InstanceData unpack(const glm::vec4& origin, std::span<const glm::vec4> palette) const {
+            InstanceData instance{};
+            const glm::uvec3 local = glm::uvec3(data, data >> 4, data >> 8) & glm::uvec3(MAX_LOCAL_POSITION);
+            instance.translation = glm::vec4(glm::vec3(origin) + glm::vec3(local) * origin.w, 1.0f);
+            instance.visibilityMask = (data >> 12) & 0x7F;
+            instance.paletteIndex = (data >> 19) & 0xFF;
+            instance.color = instance.paletteIndex < palette.size() ? palette[instance.paletteIndex] : glm::vec4(1.0f);
+            return instance;
+        }
+    };
+}
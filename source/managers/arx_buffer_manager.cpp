@@ -1,6 +1,7 @@
 #include "../source/engine_pch.hpp"
 
 #include "../source/managers/arx_buffer_manager.hpp"
+#include "../source/arx_uploader.h"
 
 namespace arx {
 
@@ -14,18 +15,35 @@ namespace arx {
 
     // Occlusion Culling
     std::shared_ptr<ArxBuffer> BufferManager::largeInstanceBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::chunkOriginBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::paletteBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::meshVertexBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::meshIndexBuffer = nullptr;
     std::shared_ptr<ArxBuffer> BufferManager::faceVisibilityBuffer = nullptr;
-    std::shared_ptr<ArxBuffer> BufferManager::drawIndirectBuffer = nullptr;
-    std::shared_ptr<ArxBuffer> BufferManager::drawCommandCountBuffer = nullptr;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::drawIndirectBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::drawCommandCountBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::drawCommandStatsBuffers;
+    uint32_t BufferManager::lastDrawCommandCount = 0;
     std::shared_ptr<ArxBuffer> BufferManager::visibilityBuffer = nullptr;
     std::shared_ptr<ArxBuffer> BufferManager::instanceOffsetBuffer = nullptr;
 
     std::vector<GPUIndirectDrawCommand> BufferManager::indirectDrawData;
     std::vector<uint32_t> BufferManager::visibilityData;
+    std::shared_ptr<ArxBuffer> BufferManager::cullNodeBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::nodeChunkBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::nodeVisibilityBuffer = nullptr;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::visibleNodeBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::nodeDispatchBuffers;
+    std::shared_ptr<ArxBuffer> BufferManager::brickBuffer = nullptr;
+    std::shared_ptr<ArxBuffer> BufferManager::brickVisibilityBuffer = nullptr;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::brickChunkBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> BufferManager::brickDispatchBuffers;
     
-    // SVO
-    std::shared_ptr<ArxBuffer> BufferManager::nodeBuffer = nullptr;
-    std::shared_ptr<ArxBuffer> BufferManager::voxelBuffer = nullptr;
+    std::unique_ptr<ArxFrameRing> BufferManager::frameRing = nullptr;
+
+    void BufferManager::createFrameRing(ArxDevice &device) {
+        frameRing = std::make_unique<ArxFrameRing>(device, MAX_FRAMES_IN_FLIGHT);
+    }
 
     void BufferManager::addVertexBuffer(std::shared_ptr<ArxBuffer> buffer, VkDeviceSize offset) {
         vertexBuffers.push_back(buffer);
@@ -39,7 +57,7 @@ namespace arx {
 
     void BufferManager::addInstanceBuffer(std::shared_ptr<ArxBuffer> buffer, VkDeviceSize offset) {
         instanceBuffers.push_back(buffer);
-        instanceOffsets.push_back(offset/sizeof(InstanceData));
+        instanceOffsets.push_back(offset/sizeof(PackedInstance));
     }
 
     void BufferManager::createFaceVisibilityBuffer(ArxDevice &device, const uint32_t totalInstances) {
@@ -69,37 +87,55 @@ namespace arx {
         // Create the large instance buffer (device-local, not host-visible)
         largeInstanceBuffer = std::make_shared<ArxBuffer>(
             device,
-            sizeof(InstanceData),
-            totalInstanceBufferSize / sizeof(InstanceData),
+            sizeof(PackedInstance),
+            totalInstanceBufferSize / sizeof(PackedInstance),
             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
             VK_BUFFER_USAGE_TRANSFER_DST_BIT |
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        // Create a staging buffer (host-visible)
-        ArxBuffer stagingBuffer{
-            device,
-            sizeof(InstanceData),
-            static_cast<uint32_t>(totalInstanceBufferSize / sizeof(InstanceData)),
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
+        // The per model instance buffers are host visible already, copy straight out of them in one batch.
+        // They have to outlive the batch, see releaseInstanceBuffers
         VkDeviceSize offset = 0;
         for (size_t j = 0; j < instanceBuffers.size(); ++j) {
-            void* data = instanceBuffers[j]->getMappedMemory();
-            stagingBuffer.writeToBuffer(data, instanceBuffers[j]->getBufferSize(), offset);
+            device.uploader().copyBuffer(instanceBuffers[j]->getBuffer(), largeInstanceBuffer->getBuffer(), instanceBuffers[j]->getBufferSize(), 0, offset);
             offset += instanceBuffers[j]->getBufferSize();
         }
-        stagingBuffer.unmap();
-
-        device.copyBuffer(stagingBuffer.getBuffer(), largeInstanceBuffer->getBuffer(), totalInstanceBufferSize, 0, 0);
         
         createFaceVisibilityBuffer(device, totalInstances);
     }
 
+    void BufferManager::releaseInstanceBuffers() {
+        // Offsets stay, the G-pass still needs every model's first instance
+        instanceBuffers.clear();
+    }
+
+    std::shared_ptr<ArxBuffer> BufferManager::createDeviceLocalBuffer(ArxDevice &device, const void* data, VkDeviceSize elementSize, size_t elementCount, VkBufferUsageFlags usage) {
+        const uint32_t count = static_cast<uint32_t>(std::max<size_t>(elementCount, 1));
+
+        auto buffer = std::make_shared<ArxBuffer>(
+            device,
+            elementSize,
+            count,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+
+        device.uploader().uploadBuffer(buffer->getBuffer(), data, elementSize * elementCount);
+        return buffer;
+    }
+
+    void BufferManager::createInstanceDecodeBuffers(ArxDevice &device, std::span<const glm::vec4> chunkOrigins, std::span<const glm::vec4> palette) {
+        chunkOriginBuffer = createDeviceLocalBuffer(device, chunkOrigins.data(), sizeof(glm::vec4), chunkOrigins.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        paletteBuffer = createDeviceLocalBuffer(device, palette.data(), sizeof(glm::vec4), palette.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+
+    void BufferManager::createMeshBuffers(ArxDevice &device, std::span<const uint32_t> vertices, std::span<const uint32_t> indices) {
+        meshVertexBuffer = createDeviceLocalBuffer(device, vertices.data(), sizeof(uint32_t), vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        meshIndexBuffer = createDeviceLocalBuffer(device, indices.data(), sizeof(uint32_t), indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    }
+
     void BufferManager::bindBuffers(VkCommandBuffer commandBuffer) {
         std::vector<VkBuffer> buffers;
         std::vector<VkDeviceSize> offsets;
@@ -118,22 +154,47 @@ namespace arx {
         }
     }
 
-    uint32_t BufferManager::readDrawCommandCount() {
-        uint32_t drawCount = 0;
-        if (!drawCommandCountBuffer->getMappedMemory()) {
-            drawCommandCountBuffer->map(sizeof(uint32_t));
-        }
+    void BufferManager::createDrawCommandBuffers(ArxDevice &device) {
+        uint32_t zero = 0;
         
-        // Invalidate to fetch updated data in case of non-coherent memory
-        drawCommandCountBuffer->invalidate(sizeof(uint32_t));
-        drawCount = *static_cast<uint32_t*>(drawCommandCountBuffer->getMappedMemory());
-        return drawCount;
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            drawIndirectBuffers[i] = createDeviceLocalBuffer(device,
+                                                             indirectDrawData.data(),
+                                                             sizeof(GPUIndirectDrawCommand),
+                                                             indirectDrawData.size(),
+                                                             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+            
+            drawCommandCountBuffers[i] = createDeviceLocalBuffer(device,
+                                                                 &zero,
+                                                                 sizeof(uint32_t),
+                                                                 1,
+                                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+            
+            drawCommandStatsBuffers[i] = std::make_shared<ArxBuffer>(device,
+                                                                     sizeof(uint32_t),
+                                                                     1,
+                                                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            drawCommandStatsBuffers[i]->map();
+            drawCommandStatsBuffers[i]->writeToBuffer(&zero, sizeof(uint32_t));
+        }
     }
 
-    void BufferManager::resetDrawCommandCountBuffer(VkCommandBuffer commandBuffer) {
+    void BufferManager::resetDrawCommandCountBuffer(ArxDevice &device, VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        auto& drawCommandCountBuffer = drawCommandCountBuffers[frameIndex];
+        auto& drawIndirectBuffer = drawIndirectBuffers[frameIndex];
+        // A fixed count draw issues every slot, the ones the culling leaves alone have to stay zero instance draws
+        const bool clearCommands = !device.supportsDrawIndirectCount();
+        const uint32_t barrierCount = clearCommands ? 2 : 1;
+        
         // Ensure previous indirect command reads are completed with VK_ACCESS_INDIRECT_COMMAND_READ_BIT
-        VkBufferMemoryBarrier prefillBarrier = bufferBarrier(drawCommandCountBuffer->getBuffer(), VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &prefillBarrier, 0, 0);
+        VkBufferMemoryBarrier prefillBarriers[] = {
+            bufferBarrier(drawCommandCountBuffer->getBuffer(), VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT),
+            bufferBarrier(drawIndirectBuffer->getBuffer(), VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT)
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, barrierCount, prefillBarriers, 0, 0);
     
         vkCmdFillBuffer(commandBuffer,
                         drawCommandCountBuffer->getBuffer(),
@@ -141,10 +202,97 @@ namespace arx {
                         sizeof(uint32_t),
                         0);
         
+        if (clearCommands)
+            vkCmdFillBuffer(commandBuffer, drawIndirectBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        
         // Ensure the buffer operation is complete with VK_ACCESS_TRANSFER_WRITE_BIT
         // Allow subsequent shader stages to read from and write to this buffer
-        VkBufferMemoryBarrier fillBarrier = bufferBarrier(drawCommandCountBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &fillBarrier, 0, 0);
+        VkBufferMemoryBarrier fillBarriers[] = {
+            bufferBarrier(drawCommandCountBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+            bufferBarrier(drawIndirectBuffer->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT)
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, barrierCount, fillBarriers, 0, 0);
+    }
+
+    void BufferManager::copyDrawCommandCount(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        VkBufferMemoryBarrier copyBarrier = bufferBarrier(drawCommandCountBuffers[frameIndex]->getBuffer(), VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &copyBarrier, 0, 0);
+        
+        VkBufferCopy region{0, 0, sizeof(uint32_t)};
+        vkCmdCopyBuffer(commandBuffer, drawCommandCountBuffers[frameIndex]->getBuffer(), drawCommandStatsBuffers[frameIndex]->getBuffer(), 1, &region);
+        
+        VkBufferMemoryBarrier hostBarrier = bufferBarrier(drawCommandStatsBuffers[frameIndex]->getBuffer(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, 0, 1, &hostBarrier, 0, 0);
+    }
+
+    void BufferManager::updateDrawCommandStats(uint32_t frameIndex) {
+        lastDrawCommandCount = *static_cast<uint32_t*>(drawCommandStatsBuffers[frameIndex]->getMappedMemory());
+    }
+
+    void BufferManager::createCullNodeBuffers(ArxDevice &device, std::span<const GPUCullNode> nodes, std::span<const uint32_t> nodeChunks) {
+        cullNodeBuffer = createDeviceLocalBuffer(device, nodes.data(), sizeof(GPUCullNode), nodes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        nodeChunkBuffer = createDeviceLocalBuffer(device, nodeChunks.data(), sizeof(uint32_t), nodeChunks.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        
+        // Every node starts visible like the chunks, the first late pass settles it
+        std::vector<uint32_t> nodeVisibility(nodes.size(), 1);
+        nodeVisibilityBuffer = createDeviceLocalBuffer(device, nodeVisibility.data(), sizeof(uint32_t), nodeVisibility.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        
+        // Group counts y and z stay one, only x is reset and counted
+        const VkDispatchIndirectCommand dispatch{0, 1, 1};
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            visibleNodeBuffers[i] = std::make_shared<ArxBuffer>(device,
+                                                                sizeof(uint32_t),
+                                                                static_cast<uint32_t>(std::max<size_t>(nodes.size(), 1)),
+                                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            
+            nodeDispatchBuffers[i] = createDeviceLocalBuffer(device,
+                                                             &dispatch,
+                                                             sizeof(VkDispatchIndirectCommand),
+                                                             1,
+                                                             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        }
+    }
+
+    void BufferManager::createBrickBuffers(ArxDevice &device, std::span<const GPUBrick> bricks, uint32_t chunkCount) {
+        brickBuffer = createDeviceLocalBuffer(device, bricks.data(), sizeof(GPUBrick), bricks.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        
+        std::vector<uint32_t> brickVisibility(bricks.size(), 1);
+        brickVisibilityBuffer = createDeviceLocalBuffer(device, brickVisibility.data(), sizeof(uint32_t), brickVisibility.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        
+        const VkDispatchIndirectCommand dispatch{0, 1, 1};
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            brickChunkBuffers[i] = std::make_shared<ArxBuffer>(device,
+                                                               sizeof(uint32_t),
+                                                               std::max(chunkCount, 1u),
+                                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            
+            brickDispatchBuffers[i] = createDeviceLocalBuffer(device,
+                                                              &dispatch,
+                                                              sizeof(VkDispatchIndirectCommand),
+                                                              1,
+                                                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        }
+    }
+
+    void BufferManager::resetCullDispatchBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        VkBuffer dispatchBuffers[] = {nodeDispatchBuffers[frameIndex]->getBuffer(), brickDispatchBuffers[frameIndex]->getBuffer()};
+        
+        // The previous pass' indirect dispatches have to be done reading them
+        VkBufferMemoryBarrier prefillBarriers[2];
+        VkBufferMemoryBarrier fillBarriers[2];
+        for (int i = 0; i < 2; i++) {
+            prefillBarriers[i] = bufferBarrier(dispatchBuffers[i], VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            fillBarriers[i] = bufferBarrier(dispatchBuffers[i], VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+        
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 2, prefillBarriers, 0, 0);
+        
+        for (VkBuffer dispatchBuffer : dispatchBuffers)
+            vkCmdFillBuffer(commandBuffer, dispatchBuffer, 0, sizeof(uint32_t), 0);
+        
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 2, fillBarriers, 0, 0);
     }
 
     VkBufferMemoryBarrier BufferManager::bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask) {
@@ -161,126 +309,29 @@ namespace arx {
         return result;
     }
 
-    void BufferManager::createNodeBuffer(ArxDevice &device, const std::vector<GPUNode>& nodes) {
-        VkDeviceSize bufferSize = sizeof(GPUNode) * nodes.size();
-
-        ArxBuffer stagingBuffer{
-            device,
-            bufferSize,
-            1,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)nodes.data());
-
-        nodeBuffer = std::make_shared<ArxBuffer>(
-            device,
-            bufferSize,
-            1,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        device.copyBuffer(stagingBuffer.getBuffer(), nodeBuffer->getBuffer(), bufferSize);
-    }
-
-    void BufferManager::createVoxelBuffer(ArxDevice &device, const std::vector<InstanceData>& voxels) {
-        VkDeviceSize bufferSize = sizeof(InstanceData) * voxels.size();
-
-        ArxBuffer stagingBuffer{
-            device,
-            bufferSize,
-            1,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)voxels.data());
-
-        voxelBuffer = std::make_shared<ArxBuffer>(
-            device,
-            bufferSize,
-            1,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | // remove SRC when you delete the printVoxelData()
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        device.copyBuffer(stagingBuffer.getBuffer(), voxelBuffer->getBuffer(), bufferSize);
-    }
-
-    void BufferManager::createSVOBuffers(ArxDevice &device, const std::vector<GPUNode>& nodes, const std::vector<InstanceData>& voxels) {
-        createNodeBuffer(device, nodes);
-        createVoxelBuffer(device, voxels);
-   }
-
-    void BufferManager::printVoxelData(ArxDevice& device) {
-        if (!voxelBuffer) {
-            ARX_LOG_WARNING("Voxel buffer is not initialized.");
-            return;
-        }
-
-        VkDeviceSize bufferSize = voxelBuffer->getBufferSize();
-        
-        // Create a staging buffer
-        ArxBuffer stagingBuffer{
-            device,
-            bufferSize,
-            1,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        };
-
-        // Copy data from device local buffer to staging buffer
-        device.copyBuffer(voxelBuffer->getBuffer(), stagingBuffer.getBuffer(), bufferSize);
-
-        // Map the staging buffer
-        void* mappedMemory = nullptr;
-        stagingBuffer.map();
-        mappedMemory = stagingBuffer.getMappedMemory();
-
-        // Read and print the data
-        InstanceData* voxels = reinterpret_cast<InstanceData*>(mappedMemory);
-        size_t voxelCount = bufferSize / sizeof(InstanceData);
-
-        std::cout << "Voxel Data:" << std::endl;
-        for (size_t i = 0; i < voxelCount; ++i) {
-            const auto& voxel = voxels[i];
-            std::cout << "Voxel " << i << ":" << std::endl;
-            std::cout << "  Translation: (" << voxel.translation.x << ", "
-                                            << voxel.translation.y << ", "
-                                            << voxel.translation.z << ", "
-                                            << voxel.translation.w << ")" << std::endl;
-            std::cout << "  Color: (" << voxel.color.x << ", "
-                                      << voxel.color.y << ", "
-                                      << voxel.color.z << ", "
-                                      << voxel.color.w << ")" << std::endl;
-            std::cout << "  Visibility Mask: 0x" << std::hex << voxel.visibilityMask << std::dec << std::endl;
-            std::cout << std::endl;
-        }
-
-        // Unmap the staging buffer
-        stagingBuffer.unmap();
-    }
-
     void arx::BufferManager::cleanup() {
-        drawIndirectBuffer.reset();
-        drawCommandCountBuffer.reset();
+        drawIndirectBuffers.fill(nullptr);
+        drawCommandCountBuffers.fill(nullptr);
+        drawCommandStatsBuffers.fill(nullptr);
         instanceOffsetBuffer.reset();
         visibilityBuffer.reset();
-
-        nodeBuffer.reset();
-        voxelBuffer.reset();
+        cullNodeBuffer.reset();
+        nodeChunkBuffer.reset();
+        nodeVisibilityBuffer.reset();
+        visibleNodeBuffers.fill(nullptr);
+        nodeDispatchBuffers.fill(nullptr);
+        brickBuffer.reset();
+        brickVisibilityBuffer.reset();
+        brickChunkBuffers.fill(nullptr);
+        brickDispatchBuffers.fill(nullptr);
 
         largeInstanceBuffer.reset();
+        chunkOriginBuffer.reset();
+        paletteBuffer.reset();
+        meshVertexBuffer.reset();
+        meshIndexBuffer.reset();
         faceVisibilityBuffer.reset();
+        frameRing.reset();
 
         for (auto& buffer : vertexBuffers) {
             buffer.reset();
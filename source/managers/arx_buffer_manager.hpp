@@ -1,23 +1,25 @@
 #pragma once
 
 #include "../../source/arx_buffer.h"
+#include "../../source/arx_frame_ring.h"
+#include "../../source/geometry/voxelTypes.hpp"
+
+#include <span>
 
 namespace arx {
 
-    // SVO Nodes
-    struct GPUNode {
-        glm::vec3 min;
-        glm::vec3 max;
-        uint32_t childrenStartIndex;
-        uint32_t voxelStartIndex;
+    // Culling node, the chunks of one octree leaf cell. svo_node_culling.comp tests it before any of its chunks
+    struct GPUCullNode {
+        glm::vec4 aabbMin;  // Tight bounds of its chunks
+        glm::vec4 aabbMax;
+        glm::uvec4 chunks{0}; // First entry and count in the node chunk list
     };
 
-    // Per-instance data block
-    struct InstanceData {
-        glm::vec4 translation{};
-        glm::vec4 color{};
-        uint32_t visibilityMask{0x3F};
-        uint32_t padding[3];
+    // Chunk::Brick for brick_culling.comp, bricks of a chunk are contiguous from GPUObjectData::bricks.x
+    struct GPUBrick {
+        glm::vec4 aabbMin;
+        glm::vec4 aabbMax;
+        glm::uvec4 instances{0}; // First instance from the chunk's instance offset, count
     };
 
     struct GPUIndirectDrawCommand {
@@ -36,37 +38,75 @@ namespace arx {
 
         static void bindBuffers(VkCommandBuffer commandBuffer);
         static void createLargeInstanceBuffer(ArxDevice &device, const uint32_t totalInstances);
+        // Frees the per model copy sources, only after the uploader committed the large instance buffer
+        static void releaseInstanceBuffers();
         static void createFaceVisibilityBuffer(ArxDevice &device, const uint32_t totalInstances);
-        static uint32_t readDrawCommandCount();
-        static void resetDrawCommandCountBuffer(VkCommandBuffer commandBuffer);
+        // Draw commands start out as indirectDrawData, the counts at zero
+        static void createDrawCommandBuffers(ArxDevice &device);
+        // Clears the frame's count, and its commands too when the device draws a fixed count
+        static void resetDrawCommandCountBuffer(ArxDevice &device, VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        // Copies the final count out for the editor, after the late cull
+        static void copyDrawCommandCount(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        // Picks up the count the frame's slot was left with by its last use, only valid once its fence was waited on
+        static void updateDrawCommandStats(uint32_t frameIndex);
+        // Hierarchy nodes and the chunk indices they own, the per-frame lists and dispatch arguments the node pass fills
+        static void createCullNodeBuffers(ArxDevice &device,
+                                          std::span<const GPUCullNode> nodes,
+                                          std::span<const uint32_t> nodeChunks);
+        // Bricks with the chunk list brick_culling.comp dispatches over, sized for every chunk in one pass
+        static void createBrickBuffers(ArxDevice &device, std::span<const GPUBrick> bricks, uint32_t chunkCount);
+        // Zeroes the frame's node and brick dispatch group counts before a culling pass
+        static void resetCullDispatchBuffers(VkCommandBuffer commandBuffer, uint32_t frameIndex);
         static VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask);
         
         static void cleanup();
         
-        // occlusion_culling.comp
-        static std::shared_ptr<ArxBuffer> drawIndirectBuffer;
-        static std::shared_ptr<ArxBuffer> drawCommandCountBuffer;
+        // Per-frame uniforms, see ArxFrameRing. The renderer starts a slice in beginFrame
+        static std::unique_ptr<ArxFrameRing> frameRing;
+        static void createFrameRing(ArxDevice &device);
+        
+        // occlusion_culling.comp, draw commands and their count are written every frame so each frame in flight has its own
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> drawIndirectBuffers;
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> drawCommandCountBuffers; // Device local, the G-pass reads them as the draw count
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> drawCommandStatsBuffers;  // Host visible copies of the counts
+        static uint32_t lastDrawCommandCount; // Latest updateDrawCommandStats, for display
         static std::shared_ptr<ArxBuffer> instanceOffsetBuffer;
         static std::shared_ptr<ArxBuffer> visibilityBuffer;
         static std::vector<GPUIndirectDrawCommand> indirectDrawData;
         static std::vector<uint32_t> visibilityData;
         
+        // svo_node_culling.comp, surviving nodes and the indirect dispatch over them are rewritten by both passes each frame
+        static std::shared_ptr<ArxBuffer> cullNodeBuffer;
+        static std::shared_ptr<ArxBuffer> nodeChunkBuffer;
+        static std::shared_ptr<ArxBuffer> nodeVisibilityBuffer; // Late pass result, shared like visibilityBuffer
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> visibleNodeBuffers;
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> nodeDispatchBuffers; // VkDispatchIndirectCommand
+        static std::shared_ptr<ArxBuffer> brickBuffer;
+        static std::shared_ptr<ArxBuffer> brickVisibilityBuffer;
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> brickChunkBuffers; // Chunks whose bricks are culled, high bit visible last frame
+        static std::array<std::shared_ptr<ArxBuffer>, MAX_FRAMES_IN_FLIGHT> brickDispatchBuffers;
+        
         // vertex shader
         static std::shared_ptr<ArxBuffer> largeInstanceBuffer;
+        static std::shared_ptr<ArxBuffer> chunkOriginBuffer;
+        static std::shared_ptr<ArxBuffer> paletteBuffer;
         
-        // face visibility
-        static std::shared_ptr<ArxBuffer> faceVisibilityBuffer;
+        // chunkOrigins are indexed by PackedInstance::chunkIndex, the palette by its palette index
+        static void createInstanceDecodeBuffers(ArxDevice &device,
+                                                std::span<const glm::vec4> chunkOrigins,
+                                                std::span<const glm::vec4> palette);
         
-        // SVO
-        static void createSVOBuffers(ArxDevice &device, 
-                                     const std::vector<GPUNode>& nodes,
-                                     const std::vector<InstanceData>& voxels);
+        // Greedy meshed G-pass, vertices are pulled in gbuffer_mesh.vert, see GreedyMesher
+        static std::shared_ptr<ArxBuffer> meshVertexBuffer;
+        static std::shared_ptr<ArxBuffer> meshIndexBuffer;
         
-        static std::shared_ptr<ArxBuffer> nodeBuffer;
-        static std::shared_ptr<ArxBuffer> voxelBuffer;
+        static void createMeshBuffers(ArxDevice &device,
+                                      std::span<const uint32_t> vertices,
+                                      std::span<const uint32_t> indices);
+        
+        // face visibility
+        static std::shared_ptr<ArxBuffer> faceVisibilityBuffer;
         
-        static void printVoxelData(ArxDevice &device);
-
         static std::vector<std::shared_ptr<ArxBuffer>> vertexBuffers;
         static std::vector<VkDeviceSize> vertexOffsets;
         static std::vector<std::shared_ptr<ArxBuffer>> indexBuffers;
@@ -75,8 +115,11 @@ namespace arx {
         static std::vector<VkDeviceSize> instanceOffsets;
         
     private:
-        // SVO
-        static void createNodeBuffer(ArxDevice &device, const std::vector<GPUNode>& nodes);
-        static void createVoxelBuffer(ArxDevice &device, const std::vector<InstanceData>& voxels);
+        // Staged upload into a new device local buffer, empty data still gets one element so it can be bound
+        static std::shared_ptr<ArxBuffer> createDeviceLocalBuffer(ArxDevice &device,
+                                                                  const void* data,
+                                                                  VkDeviceSize elementSize,
+                                                                  size_t elementCount,
+                                                                  VkBufferUsageFlags usage);
     };
 }
@@ -1,6 +1,8 @@
 #include "../source/engine_pch.hpp"
 
 #include "../source/managers/arx_texture_manager.hpp"
+#include "../source/arx_buffer.h"
+#include "../source/arx_uploader.h"
 
 namespace arx {
 
@@ -12,12 +14,12 @@ namespace arx {
 
     void TextureManager::cleanup() {
         for (auto& pair : textures) {
-            pair.second->destroy(device.device());
+            pair.second->destroy(device);
         }
         textures.clear();
         
         for (auto& pair : attachments) {
-            pair.second->destroy(device.device());
+            pair.second->destroy(device);
         }
         attachments.clear();
         
@@ -47,7 +49,7 @@ namespace arx {
     void TextureManager::deleteAttachment(const std::string& name) {
         auto it = attachments.find(name);
         if (it != attachments.end()) {
-            it->second->destroy(device.device());
+            it->second->destroy(device);
             attachments.erase(it);
         } else {
             ARX_LOG_ERROR("Attachment {} not found!", name);
@@ -71,7 +73,7 @@ namespace arx {
         texture->height = height;
         texture->format = format;
 
-        createImage(width, height, format, usage, properties, mipLevels, numSamples, tiling, texture->image, texture->memory);
+        createImage(width, height, format, usage, properties, mipLevels, numSamples, tiling, texture->image, texture->allocation);
         texture->view = createImageView(texture->image, format, aspectFlags, mipLevels);
         texture->sampler = createSampler();
 
@@ -104,7 +106,7 @@ namespace arx {
         return it->second;
     }
 
-    void TextureManager::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkImageTiling tiling, VkImage& image, VkDeviceMemory& imageMemory) {
+    void TextureManager::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkImageTiling tiling, VkImage& image, ArxAllocation*& allocation) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType     = VK_IMAGE_TYPE_2D;
@@ -124,19 +126,7 @@ namespace arx {
             ARX_LOG_ERROR("failed to create image!");
         }
         
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
-        
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, properties);
-        
-        if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-            ARX_LOG_ERROR("failed to allocate image memory!");
-        }
-        
-        vkBindImageMemory(device.device(), image, imageMemory, 0);
+        allocation = device.allocator().allocateImage(image, properties);
     }
 
     VkImageView TextureManager::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
@@ -175,14 +165,14 @@ namespace arx {
         assert(aspectMask > 0);
 
         VkImage image;
-        VkDeviceMemory imageMemory;
-        createImage(width, height, format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, image, imageMemory);
+        ArxAllocation* allocation;
+        createImage(width, height, format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, image, allocation);
 
         VkImageView imageView = createImageView(image, format, aspectMask, 1);
 
         std::shared_ptr<FrameBufferAttachment> attachment = std::make_shared<FrameBufferAttachment>();
         attachment->texture.image = image;
-        attachment->texture.memory = imageMemory;
+        attachment->texture.allocation = allocation;
         attachment->texture.view = imageView;
         attachment->texture.format = format;
 
@@ -301,105 +291,11 @@ namespace arx {
         texture->width = width;
         texture->height = height;
 
-        // Raw image data staging
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        VkBufferCreateInfo bufferCreateInfo = {};
-        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferCreateInfo.size = bufferSize;
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (vkCreateBuffer(device.device(), &bufferCreateInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-            ARX_LOG_ERROR("failed to create buffer in createTexture2DFromBuffer!");
-        }
-
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements(device.device(), stagingBuffer, &memReqs);
-
-        VkMemoryAllocateInfo memAllocInfo = {};
-        memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memAllocInfo.allocationSize = memReqs.size;
-        memAllocInfo.memoryTypeIndex = device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        if (vkAllocateMemory(device.device(), &memAllocInfo, nullptr, &stagingMemory) != VK_SUCCESS) {
-            ARX_LOG_ERROR("failed to allocate buffer memory in createTexture2DFromBuffer!");
-        }
-
-        vkBindBufferMemory(device.device(), stagingBuffer, stagingMemory, 0);
-
-        // Copy texture data into staging buffer
-        void* data;
-        vkMapMemory(device.device(), stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, buffer, static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device.device(), stagingMemory);
-
         // Create the image
-        createImage(width, height, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, texture->image, texture->memory);
-
-        // Use a command buffer for copy and layout transitions
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-        // Transition the image to be a valid copy destination
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = texture->image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        // Copy buffer to image
-        VkBufferImageCopy bufferCopyRegion = {};
-        bufferCopyRegion.bufferOffset = 0;
-        bufferCopyRegion.bufferRowLength = 0;
-        bufferCopyRegion.bufferImageHeight = 0;
-        bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        bufferCopyRegion.imageSubresource.mipLevel = 0;
-        bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-        bufferCopyRegion.imageSubresource.layerCount = 1;
-        bufferCopyRegion.imageOffset = { 0, 0, 0 };
-        bufferCopyRegion.imageExtent = { width, height, 1 };
-
-        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-        // Transition the image to be shader readable
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = imageLayout;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        device.endSingleTimeCommands(commandBuffer);
+        createImage(width, height, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, texture->image, texture->allocation);
 
-        // Clean up staging resources
-        vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
-        vkFreeMemory(device.device(), stagingMemory, nullptr);
+        // Copy and layout transitions are recorded into the upload batch, the load phase commits them
+        device.uploader().uploadImage(texture->image, buffer, bufferSize, width, height, imageLayout);
 
         // Create image view
         texture->view = createImageView(texture->image, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
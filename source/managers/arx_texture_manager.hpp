@@ -1,5 +1,5 @@
 #pragma once
-#include "../../source/arx_device.h"
+#include "../../source/arx_allocator.h"
 
 
 namespace arx {
@@ -7,19 +7,19 @@ namespace arx {
     class Texture {
     public:
         VkImage         image;
-        VkDeviceMemory  memory;
+        ArxAllocation*  allocation = nullptr;
         VkImageView     view;
         VkFormat        format;
         VkSampler       sampler = VK_NULL_HANDLE;
         uint32_t        width;
         uint32_t        height;
 
-        void destroy(VkDevice device) {
-            vkDestroyImageView(device, view, nullptr);
-            vkDestroyImage(device, image, nullptr);
-            vkFreeMemory(device, memory, nullptr);
+        void destroy(ArxDevice& device) {
+            vkDestroyImageView(device.device(), view, nullptr);
+            vkDestroyImage(device.device(), image, nullptr);
+            device.allocator().free(allocation);
             if (sampler)
-                vkDestroySampler(device, sampler, nullptr);
+                vkDestroySampler(device.device(), sampler, nullptr);
         }
     };
 
@@ -27,7 +27,7 @@ namespace arx {
     public:
         Texture texture;
 
-        void destroy(VkDevice device) {
+        void destroy(ArxDevice& device) {
             texture.destroy(device);
         }
     };
@@ -91,6 +91,6 @@ namespace arx {
             VkSampleCountFlagBits numSamples,
             VkImageTiling tiling,
             VkImage& image,
-            VkDeviceMemory& imageMemory);
+            ArxAllocation*& allocation);
     };
 }
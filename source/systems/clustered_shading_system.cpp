@@ -3,6 +3,7 @@
 #include "../source/systems/clustered_shading_system.hpp"
 #include "../source/arx_frame_info.h"
 #include "../source/geometry/blockMaterials.hpp"
+#include "../source/managers/arx_buffer_manager.hpp"
 
 namespace arx {
     ArxDevice* ClusteredShading::arxDevice = nullptr;
@@ -12,23 +13,25 @@ namespace arx {
     VkPipelineLayout                        ClusteredShading::pipelineLayoutCluster;
     std::unique_ptr<ArxPipeline>            ClusteredShading::pipelineCluster;
     std::unique_ptr<ArxDescriptorPool>      ClusteredShading::descriptorPoolCluster;
-    VkDescriptorSet                         ClusteredShading::descriptorSetCluster;
+    std::array<VkDescriptorSet, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::descriptorSetsCluster;
+    uint32_t                                ClusteredShading::frustumOffset = 0;
+    ClusteredShading::Frustum               ClusteredShading::boundsFrustum{};
+    std::array<bool, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::boundsDirty{};
 
-    std::shared_ptr<ArxBuffer>  ClusteredShading::clusterLightsBuffer;
-    std::shared_ptr<ArxBuffer>  ClusteredShading::clusterBoundsBuffer;
-    std::shared_ptr<ArxBuffer>  ClusteredShading::frustumParams;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::clusterLightsBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::clusterBoundsBuffers;
+    std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::lightIndexBuffers;
+    uint32_t                                                                    ClusteredShading::lightIndexCapacity = 0;
 
     // Cluster Culling
     std::unique_ptr<ArxDescriptorSetLayout>     ClusteredShading::descriptorSetLayoutCulling;
     VkPipelineLayout                            ClusteredShading::pipelineLayoutCulling;
     std::unique_ptr<ArxPipeline>                ClusteredShading::pipelineCulling;
+    std::unique_ptr<ArxPipeline>                ClusteredShading::pipelineLightOffsets;
     std::unique_ptr<ArxDescriptorPool>          ClusteredShading::descriptorPoolCulling;
-    VkDescriptorSet                             ClusteredShading::descriptorSetCulling;
+    std::array<VkDescriptorSet, BufferManager::MAX_FRAMES_IN_FLIGHT> ClusteredShading::descriptorSetsCulling;
+    uint32_t                                    ClusteredShading::binningOffset = 0;
 
-    std::shared_ptr<ArxBuffer> ClusteredShading::pointLightsBuffer;
-    std::shared_ptr<ArxBuffer> ClusteredShading::lightCountBuffer;
-    std::shared_ptr<ArxBuffer> ClusteredShading::viewMatrixBuffer;
-    std::shared_ptr<ArxBuffer> ClusteredShading::maxDistanceBuffer;
 
 
     unsigned int ClusteredShading::width;
@@ -60,22 +63,19 @@ namespace arx {
         vkDestroyPipelineLayout(arxDevice->device(), pipelineLayoutCulling, nullptr);
         descriptorSetLayoutCulling.reset();
         pipelineCulling.reset();
+        pipelineLightOffsets.reset();
         descriptorPoolCulling.reset();
         
-        clusterLightsBuffer.reset();
-        clusterBoundsBuffer.reset();
-        frustumParams.reset();
-        pointLightsBuffer.reset();
-        lightCountBuffer.reset();
-        viewMatrixBuffer.reset();
-        maxDistanceBuffer.reset();
+        clusterLightsBuffers.fill(nullptr);
+        clusterBoundsBuffers.fill(nullptr);
+        lightIndexBuffers.fill(nullptr);
     }
 
     void ClusteredShading::createDescriptorSetLayout() {
         // Frustum Cluster
         descriptorSetLayoutCluster = ArxDescriptorSetLayout::Builder(*arxDevice)
             .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Cluster Lights
-            .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Frustum 
+            .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT) // Frustum
             .build();
         
         // Cluster Culling
@@ -83,9 +83,8 @@ namespace arx {
             .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
             .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
             .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-            .addBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-            .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-            .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT) // Light binning
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // Light index list
             .build();
     }
 
@@ -106,12 +105,19 @@ namespace arx {
         
         // Cluster Culling
         {
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset        = 0;
+            pushConstantRange.size          = sizeof(LightListData);
+            
             std::vector<VkDescriptorSetLayout> descriptorSetLayouts{descriptorSetLayoutCulling->getDescriptorSetLayout()};
             
             VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-            pipelineLayoutInfo.sType            = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            pipelineLayoutInfo.setLayoutCount   = static_cast<uint32_t>(descriptorSetLayouts.size());
-            pipelineLayoutInfo.pSetLayouts      = descriptorSetLayouts.data();
+            pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount           = static_cast<uint32_t>(descriptorSetLayouts.size());
+            pipelineLayoutInfo.pSetLayouts              = descriptorSetLayouts.data();
+            pipelineLayoutInfo.pushConstantRangeCount   = 1;
+            pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
             
             if (vkCreatePipelineLayout(arxDevice->device(), &pipelineLayoutInfo, nullptr, &pipelineLayoutCulling) != VK_SUCCESS) {
                 ARX_LOG_ERROR("failed to create cluster culling pipeline layout!");
@@ -133,98 +139,86 @@ namespace arx {
         pipelineCulling = std::make_unique<ArxPipeline>(*arxDevice,
                                                  "shaders/cluster_cullLight.spv",
                                                  pipelineLayoutCulling);
+        
+        pipelineLightOffsets = std::make_unique<ArxPipeline>(*arxDevice,
+                                                      "shaders/cluster_lightOffsets.spv",
+                                                      pipelineLayoutCulling);
     }
 
     void ClusteredShading::createDescriptorPool() {
         // Frustum Cluster
+        constexpr uint32_t frames = BufferManager::MAX_FRAMES_IN_FLIGHT;
+        
         descriptorPoolCluster = ArxDescriptorPool::Builder(*arxDevice)
-            .setMaxSets(1)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f)
+            .setMaxSets(frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frames)
             .build();
         
         // Cluster Culling
         descriptorPoolCulling = ArxDescriptorPool::Builder(*arxDevice)
-            .setMaxSets(1)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3.0f)
+            .setMaxSets(frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frames)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frames)
             .build();
     }
 
     void ClusteredShading::createDescriptorSets() {
-        // Frustum Cluster
-        clusterBoundsBuffer = std::make_shared<ArxBuffer>(*arxDevice,
-                                                        sizeof(ClusterBounds),
-                                                        numClusters,
-                                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        
-        frustumParams = std::make_shared<ArxBuffer>(*arxDevice,
-                                                    sizeof(Frustum),
-                                                    1,
-                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        
-        frustumParams->map();
-
-        
-        auto clusterBoundsBufferInfo    = clusterBoundsBuffer->descriptorInfo();
-        auto frustumParamsInfo          = frustumParams->descriptorInfo();
+        auto frustumParamsInfo          = BufferManager::frameRing->descriptorInfo(sizeof(Frustum));
+        auto lightBinningBufferInfo     = BufferManager::frameRing->descriptorInfo(sizeof(LightBinning));
         
-        ArxDescriptorWriter(*descriptorSetLayoutCluster, *descriptorPoolCluster)
-            .writeBuffer(0, &clusterBoundsBufferInfo)
-            .writeBuffer(1, &frustumParamsInfo)
-            .build(descriptorSetCluster);
-        
-        // Cluster Culling
-        clusterLightsBuffer = std::make_shared<ArxBuffer>(*arxDevice,
-                                                        sizeof(ClusterLights),
-                                                        numClusters,
-                                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // Enough for every light in every cluster when there are few, an average budget per cluster otherwise
+        lightIndexCapacity = numClusters * std::clamp(Materials::maxPointLights, 1u, LIGHTS_PER_CLUSTER_BUDGET);
 
-        pointLightsBuffer = Materials::pointLightBuffer;
-        
-        lightCountBuffer = std::make_shared<ArxBuffer>(*arxDevice,
-                                                       sizeof(uint32_t),
-                                                       1,
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        lightCountBuffer->map();
-        lightCountBuffer->writeToBuffer(&Materials::currentPointLightCount);
-        
-        viewMatrixBuffer = std::make_shared<ArxBuffer>(*arxDevice,
-                                                       sizeof(glm::mat4),
-                                                       1,
-                                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        viewMatrixBuffer->map();
-        
-        maxDistanceBuffer = std::make_shared<ArxBuffer>(*arxDevice,
-                                                    sizeof(float),
-                                                    1,
-                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        for (uint32_t i = 0; i < BufferManager::MAX_FRAMES_IN_FLIGHT; i++) {
+            // Frustum Cluster
+            clusterBoundsBuffers[i] = std::make_shared<ArxBuffer>(*arxDevice,
+                                                                  sizeof(ClusterBounds),
+                                                                  numClusters,
+                                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            
+            auto clusterBoundsBufferInfo = clusterBoundsBuffers[i]->descriptorInfo();
+            
+            ArxDescriptorWriter(*descriptorSetLayoutCluster, *descriptorPoolCluster)
+                .writeBuffer(0, &clusterBoundsBufferInfo)
+                .writeBuffer(1, &frustumParamsInfo)
+                .build(descriptorSetsCluster[i]);
+            
+            // Cluster Culling
+            clusterLightsBuffers[i] = std::make_shared<ArxBuffer>(*arxDevice,
+                                                                  sizeof(ClusterLights),
+                                                                  numClusters,
+                                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            
+            auto clusterLightsBufferInfo = clusterLightsBuffers[i]->descriptorInfo();
+            
+            lightIndexBuffers[i] = std::make_shared<ArxBuffer>(*arxDevice,
+                                                               sizeof(uint32_t),
+                                                               lightIndexCapacity,
+                                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            
+            auto lightIndexBufferInfo = lightIndexBuffers[i]->descriptorInfo();
+            auto pointLightBufferInfo = Materials::pointLightBuffers[i]->descriptorInfo();
 
-        maxDistanceBuffer->map();
+            ArxDescriptorWriter(*descriptorSetLayoutCulling, *descriptorPoolCulling)
+                .writeBuffer(0, &clusterLightsBufferInfo)
+                .writeBuffer(1, &clusterBoundsBufferInfo)
+                .writeBuffer(2, &pointLightBufferInfo)
+                .writeBuffer(3, &lightBinningBufferInfo)
+                .writeBuffer(4, &lightIndexBufferInfo)
+                .build(descriptorSetsCulling[i]);
+        }
+    }
 
-        VkDescriptorBufferInfo pointLightBufferInfo{};
-        if (Materials::maxPointLights > 0)
-            pointLightBufferInfo = pointLightsBuffer->descriptorInfo();
+    void ClusteredShading::updateLightBuffer(uint32_t frameIndex) {
+        auto pointLightBufferInfo = Materials::pointLightBuffers[frameIndex]->descriptorInfo();
         
-        auto clusterLightsBufferInfo    = clusterLightsBuffer->descriptorInfo();
-        auto lightCountBufferInfo       = lightCountBuffer->descriptorInfo();
-        auto viewMatrixBufferInfo       = viewMatrixBuffer->descriptorInfo();
-        auto maxDistanceBufferInfo      = maxDistanceBuffer->descriptorInfo();
-
         ArxDescriptorWriter(*descriptorSetLayoutCulling, *descriptorPoolCulling)
-            .writeBuffer(0, &clusterLightsBufferInfo)
-            .writeBuffer(1, &clusterBoundsBufferInfo)
             .writeBuffer(2, &pointLightBufferInfo)
-            .writeBuffer(3, &viewMatrixBufferInfo)
-            .writeBuffer(4, &lightCountBufferInfo)
-            .writeBuffer(5, &maxDistanceBufferInfo)
-            .build(descriptorSetCulling);
+            .overwrite(descriptorSetsCulling[frameIndex]);
     }
 
     void ClusteredShading::updateUniforms(GlobalUbo &rhs, glm::vec2 extent, float maxDistance) {
@@ -234,19 +228,40 @@ namespace arx {
         params.zFar = rhs.zFar;
         params.gridSize = glm::uvec3(gridSizeX, gridSizeY, gridSizeZ);
         params.screenDimensions = glm::uvec2(extent.x, extent.y);
-            
-        frustumParams->writeToBuffer(&params);
+        
+        // The bounds only depend on these, a moving camera keeps them
+        if (params.inverseProjection != boundsFrustum.inverseProjection ||
+            params.screenDimensions != boundsFrustum.screenDimensions ||
+            params.zNear != boundsFrustum.zNear ||
+            params.zFar != boundsFrustum.zFar) {
+            boundsFrustum = params;
+            boundsDirty.fill(true);
+        }
+        
+        if (std::find(boundsDirty.begin(), boundsDirty.end(), true) != boundsDirty.end())
+            frustumOffset = BufferManager::frameRing->push(params);
 
-        viewMatrixBuffer->writeToBuffer(&rhs.view);
+        LightBinning binning{};
+        binning.view = rhs.view;
+        binning.projection = rhs.projection;
+        binning.gridSize = glm::uvec4(gridSizeX, gridSizeY, gridSizeZ, 0);
+        binning.zNear = rhs.zNear;
+        binning.zFar = rhs.zFar;
         // maxDistance *= 0.66;
-        maxDistanceBuffer->writeToBuffer(&maxDistance);
+        binning.maxDistance = maxDistance;
+        
+        binningOffset = BufferManager::frameRing->push(binning);
     }
 
-    void ClusteredShading::dispatchComputeFrustumCluster(VkCommandBuffer commandBuffer) {
+    void ClusteredShading::dispatchComputeFrustumCluster(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        if (!boundsDirty[frameIndex]) return;
+        boundsDirty[frameIndex] = false;
+        
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineCluster->computePipeline);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayoutCluster, 0, 1, &descriptorSetCluster, 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayoutCluster, 0, 1, &descriptorSetsCluster[frameIndex], 1, &frustumOffset);
 
-        vkCmdDispatch(commandBuffer, gridSizeX, gridSizeY, gridSizeZ);
+        // Matches the 4x4x4 workgroups of frustum_clusters.comp
+        vkCmdDispatch(commandBuffer, (gridSizeX + 3) / 4, (gridSizeY + 3) / 4, (gridSizeZ + 3) / 4);
 
         VkMemoryBarrier barrier = {};
         barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -261,19 +276,44 @@ namespace arx {
                             0, nullptr);
     }
 
-    void ClusteredShading::dispatchComputeClusterCulling(VkCommandBuffer commandBuffer) {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineCulling->computePipeline);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayoutCulling, 0, 1, &descriptorSetCulling, 0, nullptr);
-
-        vkCmdDispatch(commandBuffer, 27, 1, 1);
-
+    void ClusteredShading::dispatchComputeClusterCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayoutCulling, 0, 1, &descriptorSetsCulling[frameIndex], 1, &binningOffset);
+        
+        // One thread per light, the light list passes scale with light-cluster overlaps
+        // Light edits move the end of the used slots, so the count comes from the CPU every frame
+        LightListData lightListData{numClusters, lightIndexCapacity, LIGHT_LIST_COUNT, Materials::currentPointLightCount};
+        const uint32_t groupCount = (Materials::currentPointLightCount + 63) / 64;
+        
+        // Lights add themselves to the counts
+        vkCmdFillBuffer(commandBuffer, clusterLightsBuffers[frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+        
         VkMemoryBarrier barrier = {};
         barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
         barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        
+        // Count the lights of every cluster, turn the counts into offsets, then fill the list at them
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineCulling->computePipeline);
+        vkCmdPushConstants(commandBuffer, pipelineLayoutCulling, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LightListData), &lightListData);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLightOffsets->computePipeline);
+        vkCmdDispatch(commandBuffer, 1, 1, 1);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        
+        lightListData.phase = LIGHT_LIST_FILL;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineCulling->computePipeline);
+        vkCmdPushConstants(commandBuffer, pipelineLayoutCulling, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LightListData), &lightListData);
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+        // The deferred pass reads the light lists in its fragment shader
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
         vkCmdPipelineBarrier(commandBuffer,
                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                             0,
                             1, &barrier,
                             0, nullptr,
@@ -2,6 +2,7 @@
 
 #include "../source/arx_pipeline.h"
 #include "../source/arx_descriptors.h"
+#include "../source/managers/arx_buffer_manager.hpp"
 
 namespace arx {
 
@@ -11,11 +12,35 @@ namespace arx {
     class ClusteredShading {
     public:
         
-        struct alignas(16) ClusterLights
+        // Range of the cluster's lights in the light index list
+        struct ClusterLights
         {
-            unsigned int count;
-            unsigned int lightIndices[711];
+            uint32_t offset;
+            uint32_t count;
         };
+        
+        // cluster_cullLight.comp and cluster_lightOffsets.comp push constants
+        struct LightListData {
+            uint32_t clusterCount;
+            uint32_t indexCapacity;
+            uint32_t phase; // LIGHT_LIST_COUNT or LIGHT_LIST_FILL
+            uint32_t lightCount; // Light slots, tombstones included
+        };
+        
+        // What a light needs to find the clusters it reaches
+        struct LightBinning {
+            glm::mat4 view;
+            glm::mat4 projection;
+            glm::uvec4 gridSize;
+            float zNear;
+            float zFar;
+            float maxDistance;
+        };
+        
+        static constexpr uint32_t LIGHT_LIST_COUNT = 0;
+        static constexpr uint32_t LIGHT_LIST_FILL = 1;
+        // Average lights per cluster the index list is sized for, a single cluster can hold any number
+        static constexpr uint32_t LIGHTS_PER_CLUSTER_BUDGET = 128;
 
         struct alignas(16) ClusterBounds {
             glm::vec4 minPoint;
@@ -35,17 +60,17 @@ namespace arx {
         static void cleanup();
         
         static void updateUniforms(GlobalUbo &rhs, glm::vec2 extent, float maxDistance);
+        // Points frameIndex's culling set at Materials::pointLightBuffers[frameIndex] again, after flush replaced it
+        static void updateLightBuffer(uint32_t frameIndex);
         
-        static void dispatchComputeFrustumCluster(VkCommandBuffer commandBuffer);
-        static void dispatchComputeClusterCulling(VkCommandBuffer commandBuffer);
+        static void dispatchComputeFrustumCluster(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+        static void dispatchComputeClusterCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex);
         
-        static std::shared_ptr<ArxBuffer>               clusterLightsBuffer;
-        static std::shared_ptr<ArxBuffer>               clusterBoundsBuffer;
-        static std::shared_ptr<ArxBuffer>               frustumParams;
-        static std::shared_ptr<ArxBuffer>               pointLightsBuffer;
-        static std::shared_ptr<ArxBuffer>               lightCountBuffer;
-        static std::shared_ptr<ArxBuffer>               viewMatrixBuffer;
-        static std::shared_ptr<ArxBuffer>               maxDistanceBuffer;
+        // One per frame in flight, the light lists are rebuilt every frame, the bounds when the projection or extent change
+        static std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> clusterLightsBuffers;
+        static std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> clusterBoundsBuffers;
+        static std::array<std::shared_ptr<ArxBuffer>, BufferManager::MAX_FRAMES_IN_FLIGHT> lightIndexBuffers; // Every cluster's light indices back to back
+        static uint32_t                                 lightIndexCapacity;
         
         static constexpr unsigned int                   gridSizeX = 16;
         static constexpr unsigned int                   gridSizeY = 9;
@@ -73,15 +98,19 @@ namespace arx {
         static VkPipelineLayout                         pipelineLayoutCluster;
         static std::unique_ptr<ArxPipeline>             pipelineCluster;
         static std::unique_ptr<ArxDescriptorPool>       descriptorPoolCluster;
-        static VkDescriptorSet                          descriptorSetCluster;
+        static std::array<VkDescriptorSet, BufferManager::MAX_FRAMES_IN_FLIGHT> descriptorSetsCluster;
+        static uint32_t                                 frustumOffset; // Frame ring
+        static Frustum                                  boundsFrustum; // What the bounds were last built from
+        static std::array<bool, BufferManager::MAX_FRAMES_IN_FLIGHT> boundsDirty;
         
         
         // Cluster Culling
         static std::unique_ptr<ArxDescriptorSetLayout>  descriptorSetLayoutCulling;
         static VkPipelineLayout                         pipelineLayoutCulling;
         static std::unique_ptr<ArxPipeline>             pipelineCulling;
+        static std::unique_ptr<ArxPipeline>             pipelineLightOffsets; // Same layout as the culling
         static std::unique_ptr<ArxDescriptorPool>       descriptorPoolCulling;
-        static VkDescriptorSet                          descriptorSetCulling;
-        
+        static std::array<VkDescriptorSet, BufferManager::MAX_FRAMES_IN_FLIGHT> descriptorSetsCulling;
+        static uint32_t                                 binningOffset; // Frame ring
     };
 }
@@ -4,30 +4,36 @@
 
 namespace arx {
 
-    struct DepthReduceData {
-        glm::vec2 dimensions;
-    };
-
     OcclusionSystem::OcclusionSystem(ArxDevice &device)
         : arxDevice{device} {
         depthDescriptorLayout = ArxDescriptorSetLayout::Builder(arxDevice)
-                        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, MAX_DEPTH_PYRAMID_LEVELS)
                         .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .build();
         
         createDepthPyramidPipelineLayout();
         createDepthPyramidPipeline();
         
         cullingDescriptorLayout = ArxDescriptorSetLayout::Builder(arxDevice)
-                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-                        .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-                        .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(14, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(15, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(16, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                        .addBinding(17, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
                         .build();
             
         createCullingPipelineLayout();
@@ -36,6 +42,10 @@ namespace arx {
         // late
         createEarlyCullingPipelineLayout();
         createEarlyCullingPipeline();
+        
+        createNodeCullingPipelineLayout();
+        createNodeCullingPipeline();
+        createBrickCullingPipeline();
     }
 
     OcclusionSystem::~OcclusionSystem() {
@@ -53,12 +63,14 @@ namespace arx {
         // Destroy early culling resources
         vkDestroyPipelineLayout(arxDevice.device(), earlyCullingPipelineLayout, nullptr);
         earlyCullingPipeline.reset();
+        
+        // Destroy node culling resources
+        vkDestroyPipelineLayout(arxDevice.device(), nodeCullingPipelineLayout, nullptr);
+        nodeCullingPipeline.reset();
+        brickCullingPipeline.reset();
 
         // Destroy buffers
-        cameraBuffer.reset();
         objectsDataBuffer.reset();
-        globalDataBuffer.reset();
-        miscBuffer.reset();
     }
 
     void OcclusionSystem::cleanup() {
@@ -69,6 +81,7 @@ namespace arx {
         }
         vkDestroyImage(arxDevice.device(), depthPyramidImage, nullptr);
         vkFreeMemory(arxDevice.device(), depthPyramidMemory, nullptr);
+        depthPyramidCounterBuffer.reset();
     }
     
     void OcclusionSystem::createDepthPyramidPipelineLayout() {
@@ -144,4 +157,104 @@ namespace arx {
                                                         "shaders/occlusionEarly_culling.spv",
                                                         earlyCullingPipelineLayout);
     }
+
+    void OcclusionSystem::createNodeCullingPipelineLayout() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset        = 0;
+        pushConstantRange.size          = sizeof(NodeCullingData);
+        
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{cullingDescriptorLayout->getDescriptorSetLayout()};
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount           = static_cast<uint32_t>(descriptorSetLayouts.size());
+        pipelineLayoutInfo.pSetLayouts              = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount   = 1;
+        pipelineLayoutInfo.pPushConstantRanges      = &pushConstantRange;
+        
+        if (vkCreatePipelineLayout(arxDevice.device(), &pipelineLayoutInfo, nullptr, &nodeCullingPipelineLayout) != VK_SUCCESS) {
+            ARX_LOG_ERROR("failed to create node culling pipeline layout!");
+        }
+    }
+
+    void OcclusionSystem::createNodeCullingPipeline() {
+        assert(nodeCullingPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+        
+        nodeCullingPipeline = std::make_unique<ArxPipeline>(arxDevice,
+                                                            "shaders/svo_node_culling.spv",
+                                                            nodeCullingPipelineLayout);
+    }
+
+    void OcclusionSystem::createBrickCullingPipeline() {
+        assert(nodeCullingPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+        
+        brickCullingPipeline = std::make_unique<ArxPipeline>(arxDevice,
+                                                             "shaders/brick_culling.spv",
+                                                             nodeCullingPipelineLayout);
+    }
+
+    void OcclusionSystem::buildCullNodes() {
+        cullNodes.clear();
+        nodeChunks.clear();
+        if (objectData.data.empty()) return;
+        
+        glm::vec3 worldMin(std::numeric_limits<float>::max());
+        glm::vec3 worldMax(std::numeric_limits<float>::lowest());
+        for (const auto& object : objectData.data) {
+            worldMin = glm::min(worldMin, glm::vec3(object.aabbMin));
+            worldMax = glm::max(worldMax, glm::vec3(object.aabbMax));
+        }
+        
+        // Cubic root cell like the SVO's, so the octants split every axis evenly
+        const glm::vec3 extent = worldMax - worldMin;
+        const float size = std::max({extent.x, extent.y, extent.z});
+        
+        std::vector<uint32_t> chunks(objectData.size());
+        std::iota(chunks.begin(), chunks.end(), 0);
+        nodeChunks.reserve(chunks.size());
+        
+        splitCullNode(chunks, worldMin, worldMin + glm::vec3(size), 0);
+        
+        ARX_LOG_INFO("Culling nodes: {} buckets over {} chunks", cullNodes.size(), chunks.size());
+    }
+
+    void OcclusionSystem::splitCullNode(std::vector<uint32_t>& chunks, const glm::vec3& cellMin, const glm::vec3& cellMax, uint32_t depth) {
+        if (chunks.size() > CULL_NODE_CHUNKS && depth < MAX_CULL_NODE_DEPTH) {
+            // Chunks go to the octant holding their center
+            const glm::vec3 center = 0.5f * (cellMin + cellMax);
+            std::array<std::vector<uint32_t>, 8> octants;
+            for (uint32_t chunk : chunks) {
+                const glm::vec3 chunkCenter = 0.5f * glm::vec3(objectData.data[chunk].aabbMin + objectData.data[chunk].aabbMax);
+                const uint32_t octant = (chunkCenter.x >= center.x ? 1 : 0) | (chunkCenter.y >= center.y ? 2 : 0) | (chunkCenter.z >= center.z ? 4 : 0);
+                octants[octant].push_back(chunk);
+            }
+            
+            for (uint32_t i = 0; i < 8; i++) {
+                if (octants[i].empty()) continue;
+                const glm::vec3 octantMin(i & 1 ? center.x : cellMin.x, i & 2 ? center.y : cellMin.y, i & 4 ? center.z : cellMin.z);
+                const glm::vec3 octantMax(i & 1 ? cellMax.x : center.x, i & 2 ? cellMax.y : center.y, i & 4 ? cellMax.z : center.z);
+                splitCullNode(octants[i], octantMin, octantMax, depth + 1);
+            }
+            return;
+        }
+        
+        // Stacked chunks the depth limit can't separate are cut into several nodes
+        for (size_t first = 0; first < chunks.size(); first += CULL_NODE_CHUNKS) {
+            const size_t count = std::min<size_t>(CULL_NODE_CHUNKS, chunks.size() - first);
+            
+            GPUCullNode node{};
+            node.aabbMin = glm::vec4(std::numeric_limits<float>::max());
+            node.aabbMax = glm::vec4(std::numeric_limits<float>::lowest());
+            node.chunks = glm::uvec4(static_cast<uint32_t>(nodeChunks.size()), static_cast<uint32_t>(count), 0, 0);
+            
+            for (size_t i = first; i < first + count; i++) {
+                const auto& object = objectData.data[chunks[i]];
+                node.aabbMin = glm::vec4(glm::min(glm::vec3(node.aabbMin), glm::vec3(object.aabbMin)), 0.0f);
+                node.aabbMax = glm::vec4(glm::max(glm::vec3(node.aabbMax), glm::vec3(object.aabbMax)), 0.0f);
+                nodeChunks.push_back(chunks[i]);
+            }
+            cullNodes.push_back(node);
+        }
+    }
 }
@@ -12,7 +12,12 @@ namespace arx {
 
     class OcclusionSystem {
     public:
-        
+        // Levels depth_pyramid.comp can write, a 4096 texel mip 0
+        static constexpr uint32_t MAX_DEPTH_PYRAMID_LEVELS = 13;
+        // Chunks a culling node holds at most, the chunk passes run a workgroup of this size per surviving node
+        static constexpr uint32_t CULL_NODE_CHUNKS = 64;
+        static constexpr uint32_t MAX_CULL_NODE_DEPTH = 16;
+
         uint32_t previousPow2(uint32_t v) {
             uint32_t result = 1;
             while (result * 2 < v) result *= 2;
@@ -26,9 +31,23 @@ namespace arx {
             glm::mat4 invView;
         };
         
+        // depth_pyramid.comp push constants
+        struct DepthReduceData {
+            glm::uvec2 pyramidSize;
+            uint32_t levelCount;
+            uint32_t groupCount;
+        };
+        
+        // svo_node_culling.comp and brick_culling.comp push constants
+        struct NodeCullingData {
+            uint32_t early; // Frustum only against what was visible last frame, otherwise Hi-Z too
+        };
+        
         struct GPUMiscData {
             int occlusionCulling = 1;
             int frustumCulling = 1;
+            int greedyMeshing = 0; // Draw commands index the chunk meshes instead of instancing the cube
+            int chunkLod = 1; // Far chunks instance their 2x or 4x downsampled voxels
         };
         
         struct alignas(16) GPUCullingGlobalData {
@@ -46,8 +65,11 @@ namespace arx {
         struct alignas(16) GPUObjectDataBuffer {
             
             struct GPUObjectData {
-                glm::vec4 aabbMin;
-                glm::vec4 aabbMax;
+                glm::vec4 aabbMin; // w voxel step
+                glm::vec4 aabbMax; // w full resolution instance count
+                glm::uvec4 mesh{0}; // ChunkMesh firstIndex, indexCount, vertexOffset
+                glm::uvec4 lodCounts{0}; // 2x and 4x instance counts, stored after the full resolution ones
+                glm::uvec4 bricks{0}; // First brick and brick count, none for chunks drawn whole
             };
             
             std::vector<GPUObjectData> data;
@@ -79,22 +101,46 @@ namespace arx {
         
         void setObjectDataFromAABBs(ChunkManager& chunkManager) {
             const auto& chunkAABBs = chunkManager.getChunkAABBs();
+            const auto& chunkMeshes = chunkManager.getChunkMeshes();
             const auto& chunks = chunkManager.GetChunks();
 
             objectData.data.clear();
             objectData.data.reserve(chunkAABBs.size());
+            brickData.clear();
 
             for (const auto& chunk : chunks) {
                 GPUObjectDataBuffer::GPUObjectData gpuObjectData;
                 if (chunk->getID() == -1) continue;
-                gpuObjectData.aabbMin = glm::vec4(chunkAABBs.at(chunk->getID()).min, 1.0f);
+                gpuObjectData.aabbMin = glm::vec4(chunkAABBs.at(chunk->getID()).min, chunk->getOrigin().w);
                 gpuObjectData.aabbMax = glm::vec4(chunkAABBs.at(chunk->getID()).max, 1.0f);
-                gpuObjectData.aabbMax.w = static_cast<float>(chunk->getInstanceCount());
+                gpuObjectData.aabbMax.w = static_cast<float>(chunk->getLodCounts()[0]);
+                gpuObjectData.lodCounts = glm::uvec4(chunk->getLodCounts()[1], chunk->getLodCounts()[2], 0, 0);
+                if (auto mesh = chunkMeshes.find(chunk->getID()); mesh != chunkMeshes.end()) {
+                    gpuObjectData.mesh = glm::uvec4(mesh->second.firstIndex, mesh->second.indexCount, static_cast<uint32_t>(mesh->second.vertexOffset), 0);
+                }
+                gpuObjectData.bricks = glm::uvec4(static_cast<uint32_t>(brickData.size()), static_cast<uint32_t>(chunk->getBricks().size()), 0, 0);
+                for (const auto& brick : chunk->getBricks()) {
+                    brickData.push_back({glm::vec4(brick.min, 0.0f), glm::vec4(brick.max, 0.0f), glm::uvec4(brick.firstInstance, brick.instanceCount, 0, 0)});
+                }
                 objectData.data.push_back(gpuObjectData);
                 
                 BufferManager::visibilityData.push_back(1);
             }
+            
+            buildCullNodes();
+        }
+        
+        // A chunk draws each face direction once, whole or per brick, whichever way the culling picks
+        uint32_t maxDrawCommands() const {
+            uint32_t draws = 0;
+            for (const auto& object : objectData.data)
+                draws += FACE_COUNT * std::max(object.bricks.y, 1u);
+            return draws;
         }
+        
+        // Buckets the chunk AABBs by octree cell the way the SVO splits the world, cells stop at CULL_NODE_CHUNKS chunks.
+        // Only the leaf cells become nodes, the GPU tests them as one flat level in front of the chunks
+        void buildCullNodes();
 
         glm::vec4 normalizePlane(glm::vec4 p)
         {
@@ -114,7 +160,7 @@ namespace arx {
             cullingData.pyramidWidth = width;
             cullingData.pyramidHeight = height;
             cullingData.chunkCount = chunkCount;
-            cullingData.nodesCount = static_cast<uint32_t>(BufferManager::nodeBuffer->getBufferSize() / sizeof(GPUNode));
+            cullingData.nodesCount = static_cast<uint32_t>(cullNodes.size());
         }
         
         void cleanup();
@@ -122,12 +168,12 @@ namespace arx {
         // Depth pyramid
         std::unique_ptr<ArxDescriptorPool>          depthDescriptorPool;
         std::unique_ptr<ArxDescriptorSetLayout>     depthDescriptorLayout;
-        std::vector<VkDescriptorSet>                depthDescriptorSets;
+        VkDescriptorSet                             depthDescriptorSet;
         VkImage                                     depthPyramidImage;
         VkDeviceMemory                              depthPyramidMemory;
         VkImageView                                 depthPyramidImageView;
         std::vector<VkImageView>                    depthPyramidMips;
-        std::vector<VkImageMemoryBarrier>           depthPyramidMipLevelBarriers;
+        std::shared_ptr<ArxBuffer>                  depthPyramidCounterBuffer; // Workgroups done with their tile
         uint32_t                                    depthPyramidLevels;
         
         uint32_t                                    depthPyramidWidth;
@@ -147,7 +193,7 @@ namespace arx {
         VkPipelineLayout                            cullingPipelineLayout;
         std::unique_ptr<ArxDescriptorSetLayout>     cullingDescriptorLayout;
         std::unique_ptr<ArxDescriptorPool>          cullingDescriptorPool;
-        VkDescriptorSet                             cullingDescriptorSet;
+        std::array<VkDescriptorSet, BufferManager::MAX_FRAMES_IN_FLIGHT> cullingDescriptorSets; // Per frame draw commands and count
         
         void createCullingPipelineLayout();
         void createCullingPipeline();
@@ -159,19 +205,36 @@ namespace arx {
         void createEarlyCullingPipelineLayout();
         void createEarlyCullingPipeline();
         
+        // Hierarchy node culling ahead of both chunk passes, same descriptors
+        std::unique_ptr<ArxPipeline>                nodeCullingPipeline;
+        VkPipelineLayout                            nodeCullingPipelineLayout;
+        
+        void createNodeCullingPipelineLayout();
+        void createNodeCullingPipeline();
+        
+        // Brick culling after both chunk passes, shares the node culling layout
+        std::unique_ptr<ArxPipeline>                brickCullingPipeline;
+        
+        void createBrickCullingPipeline();
+        
         // Buffers for the compute shaders
-        std::shared_ptr<ArxBuffer>                  cameraBuffer;
         std::shared_ptr<ArxBuffer>                  objectsDataBuffer;
-        std::shared_ptr<ArxBuffer>                  globalDataBuffer;
-        std::shared_ptr<ArxBuffer>                  miscBuffer;
+        
+        // Camera, global and misc data go through the frame ring, offsets in binding order 0, 4, 5
+        std::array<uint32_t, 3>                     dynamicOffsets{};
         
         // Buffers data
         GPUCameraData                               cameraData;
         GPUObjectDataBuffer                         objectData;
         GPUCullingGlobalData                        cullingData;
         GPUMiscData                                 miscData;
+        std::vector<GPUCullNode>                    cullNodes;
+        std::vector<uint32_t>                       nodeChunks; // Object indices grouped by node
+        std::vector<GPUBrick>                       brickData;
         
     private:
+        void splitCullNode(std::vector<uint32_t>& chunks, const glm::vec3& cellMin, const glm::vec3& cellMax, uint32_t depth);
+        
         ArxDevice&                                  arxDevice;
     };
 }
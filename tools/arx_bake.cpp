@@ -0,0 +1,107 @@
+#include "../source/engine_pch.hpp"
+
+#include "../source/geometry/voxBaker.hpp"
+#include "../source/geometry/svo.hpp"
+#include "../source/geometry/sceneCache.hpp"
+
+#include <cstdio>
+#include <thread>
+#include <filesystem>
+
+// Headless .vox -> .arxscene baker. Runs the same VoxBaker::bake as ChunkManager::vox2Chunks
+// and links only arx_bake_core, no window or Vulkan, so it can run on build machines with no GPU.
+//
+//   arx_bake [--threads N] [--out-dir DIR] scene.vox [more.vox ...]
+
+namespace {
+
+    double perSecond(double count, double ms) {
+        return ms > 0.0 ? count / (ms / 1000.0) : 0.0;
+    }
+
+    void printUsage() {
+        std::printf("usage: arx_bake [--threads N] [--out-dir DIR] scene.vox [more.vox ...]\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    std::string outDir;
+    std::vector<std::string> inputs;
+    
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threadCount = std::max(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1u);
+        } else if (arg == "--out-dir" && i + 1 < argc) {
+            outDir = argv[++i];
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage();
+            return EXIT_SUCCESS;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    
+    if (inputs.empty()) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    
+    arx::ThreadPool threadPool;
+    threadPool.setThreadCount(threadCount);
+    
+    int failures = 0;
+    for (const std::string& input : inputs) {
+        std::string output = arx::SceneCache::cachePathFor(input);
+        if (!outDir.empty()) {
+            output = (std::filesystem::path(outDir) / std::filesystem::path(output).filename()).string();
+        }
+        
+        arx::SourceStamp source;
+        if (!arx::SceneCache::stampFile(input, source) || !arx::SceneCache::hashFile(input, source.hash, source.size)) {
+            std::fprintf(stderr, "%s: could not read\n", input.c_str());
+            ++failures;
+            continue;
+        }
+        
+        arx::BakedScene baked;
+        arx::BakeStats stats;
+        std::unique_ptr<arx::SVO> svo;
+        if (!arx::VoxBaker::bake(input, threadPool, baked, svo, stats)) {
+            std::fprintf(stderr, "%s: bake failed\n", input.c_str());
+            ++failures;
+            continue;
+        }
+        
+        arx::Timer::start();
+        if (!arx::SceneCache::write(output, baked, source)) {
+            std::fprintf(stderr, "%s: could not write %s\n", input.c_str(), output.c_str());
+            ++failures;
+            continue;
+        }
+        const double writeTime = arx::Timer::stop();
+        
+        const double sourceMB = source.size / (1024.0 * 1024.0);
+        const double outputMB = std::filesystem::file_size(output) / (1024.0 * 1024.0);
+        
+        std::printf("%s -> %s\n", input.c_str(), output.c_str());
+        std::printf("  load       %9.2f ms  %10.1f MB/s\n",             stats.loadTime,      perSecond(sourceMB, stats.loadTime));
+        std::printf("  occupancy  %9.2f ms  %10.3g voxels/s\n",         stats.occupancyTime, perSecond(double(stats.voxels), stats.occupancyTime));
+        std::printf("  tiles      %9.2f ms  %10.3g voxels/s on %u threads\n", stats.tileTime, perSecond(double(stats.voxels), stats.tileTime), stats.threadCount);
+        std::printf("  merge      %9.2f ms  %10.3g chunks/s\n",         stats.mergeTime,     perSecond(double(stats.chunks), stats.mergeTime));
+        std::printf("  faces      %9.2f ms  %10.3g voxels/s, %llu faces hidden across instances\n", stats.faceTime, perSecond(double(baked.instances.size()), stats.faceTime),
+                    static_cast<unsigned long long>(stats.hiddenFaces));
+        std::printf("  mesh       %9.2f ms  %10.3g chunks/s, %llu visible faces in %llu quads\n", stats.meshTime, perSecond(double(stats.chunks), stats.meshTime),
+                    static_cast<unsigned long long>(stats.visibleFaces), static_cast<unsigned long long>(stats.meshQuads));
+        std::printf("  lod        %9.2f ms  %10.3g chunks/s, %llu 2x and %llu 4x instances\n", stats.lodTime, perSecond(double(stats.chunks), stats.lodTime),
+                    static_cast<unsigned long long>(stats.lodInstances[0]), static_cast<unsigned long long>(stats.lodInstances[1]));
+        std::printf("  write      %9.2f ms  %10.1f MB/s\n",             writeTime,           perSecond(outputMB, writeTime));
+        std::printf("  total      %9.2f ms  %llu chunks, %zu instances, %llu lights extracted, %zu SVO nodes\n",
+                    stats.totalTime() + writeTime,
+                    static_cast<unsigned long long>(stats.chunks), baked.instances.size(),
+                    static_cast<unsigned long long>(stats.lights), svo->getNodes().size());
+    }
+    
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}